@@ -24,6 +24,7 @@
 #include "core_zone_manager.h"
 #include "core_gui.h"
 #include "core_public.h"
+#include "core_schedule_watcher.h"
 
 
 
@@ -36,13 +37,25 @@ namespace roah_rsbb
       CoreZoneManager zone_manager_;
       CoreGui gui_;
       CorePublic public_;
+      CoreScheduleWatcher schedule_watcher_;
 
       Subscriber devices_sub_;
 
       void
       devices_callback (roah_devices::DevicesState::ConstPtr const& msg)
       {
+        std::lock_guard<std::mutex> lock (ss_.mutex);
+        roah_devices::DevicesState const& last = *ss_.last_devices_state;
+        bool changed = (msg->bell != last.bell)
+                       || (msg->switch_1 != last.switch_1)
+                       || (msg->switch_2 != last.switch_2)
+                       || (msg->switch_3 != last.switch_3)
+                       || (msg->dimmer != last.dimmer)
+                       || (msg->blinds != last.blinds);
         ss_.last_devices_state = msg;
+        if (changed) {
+          ss_.beacon_changed();
+        }
       }
 
     public:
@@ -52,9 +65,17 @@ namespace roah_rsbb
         , zone_manager_ (ss_)
         , gui_ (ss_, public_channel_, zone_manager_)
         , public_ (ss_, zone_manager_)
+        , schedule_watcher_ (ss_, zone_manager_)
         , devices_sub_ (ss_.nh.subscribe ("/devices/state", 1, &Core::devices_callback, this))
       {
       }
+
+      ~Core()
+      {
+        CoreConfig const& config = ss_.config.get();
+        system (string ("mkdir -p " + config.log_dir).c_str());
+        ss_.metrics.dump (config.log_dir + "/metrics_" + to_string (Time::now()) + "_" + ss_.run_uuid + ".yaml");
+      }
   };
 }
 
@@ -68,7 +89,10 @@ main (int argc,
 
   roah_rsbb::Core node;
 
-  spin();
+  // Zones have their own threads, these serve the global callbacks
+  AsyncSpinner spinner (param_direct<int> ("~threads", 0));
+  spinner.start();
+  waitForShutdown();
 
   return 0;
 }
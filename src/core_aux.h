@@ -22,6 +22,8 @@
 
 #include "core_includes.h"
 
+#include <boost/enable_shared_from_this.hpp>
+
 
 
 class add_to_sting
@@ -68,13 +70,35 @@ abort_rsbb()
 
 
 
+/*
+ * Error in the benchmarks, passwords or schedule files. It is fatal at
+ * startup, while a failed reload keeps the files already loaded.
+ */
+class config_error
+  : public runtime_error
+{
+  public:
+    config_error (string const& what)
+      : runtime_error (what)
+    {
+    }
+};
+
+#define THROW_CONFIG_ERROR(args) \
+  do { \
+    ostringstream config_error_message; \
+    config_error_message << args; \
+    throw config_error (config_error_message.str()); \
+  } while (0)
+
+
+
 template<typename T> T
 yamlschedget (YAML::Node const& node,
               string const& key)
 {
   if (! node[key]) {
-    ROS_FATAL_STREAM ("Schedule file is missing a \"" << key << "\" entry!");
-    abort_rsbb();
+    THROW_CONFIG_ERROR ("Schedule file is missing a \"" << key << "\" entry!");
   }
   return node[key].as<T>();
 }
@@ -87,4 +111,122 @@ to_string (Time const& time)
   return boost::posix_time::to_simple_string (boost::date_time::c_local_adjustor<boost::posix_time::ptime>::utc_to_local (time.toBoost()));
 }
 
+
+
+/*
+ * Slot for the signals of the RSBB channels that runs the callback in a
+ * given queue, instead of the thread that received the message. Messages
+ * are appended to a pending batch, and only the first message of a batch
+ * adds a callback to the queue, which then handles all messages received
+ * until it runs. The two batches are swapped and keep their capacity, so
+ * a burst of datagrams costs one queue callback and no allocations here.
+ * Callbacks get a reference to the message, valid only during the call.
+ * The batch still pending can be removed from the queue with the address
+ * of obj as owner id, after disconnecting the slot.
+ */
+template<typename T, typename M>
+class QueuedChannelBatch
+  : public CallbackInterface
+  , public boost::enable_shared_from_this<QueuedChannelBatch<T, M>>
+{
+  public:
+    typedef void (T::*callback_t) (boost::asio::ip::udp::endpoint const&,
+                                   uint16_t,
+                                   uint16_t,
+                                   M const&);
+
+  private:
+    struct Item {
+      boost::asio::ip::udp::endpoint endpoint;
+      uint16_t comp_id;
+      uint16_t msg_type;
+      std::shared_ptr<const M> msg;
+    };
+
+    CallbackQueueInterface* queue_;
+    callback_t fp_;
+    T* obj_;
+
+    std::mutex mutex_;
+    vector<Item> pending_;
+    bool queued_;
+    // Only used by the queue thread
+    vector<Item> draining_;
+
+  public:
+    QueuedChannelBatch (CallbackQueueInterface* queue,
+                        callback_t fp,
+                        T* obj)
+      : queue_ (queue)
+      , fp_ (fp)
+      , obj_ (obj)
+      , queued_ (false)
+    {
+      pending_.reserve (16);
+      draining_.reserve (16);
+    }
+
+    void
+    push (boost::asio::ip::udp::endpoint const& endpoint,
+          uint16_t comp_id,
+          uint16_t msg_type,
+          std::shared_ptr<const M> const& msg)
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      pending_.push_back (Item{endpoint, comp_id, msg_type, msg});
+      if (! queued_) {
+        queued_ = true;
+        queue_->addCallback (this->shared_from_this(), reinterpret_cast<uint64_t> (obj_));
+      }
+    }
+
+    virtual CallResult
+    call()
+    {
+      {
+        std::lock_guard<std::mutex> lock (mutex_);
+        draining_.swap (pending_);
+        queued_ = false;
+      }
+      for (Item const& i : draining_) {
+        (obj_->*fp_) (i.endpoint, i.comp_id, i.msg_type, *i.msg);
+      }
+      draining_.clear();
+      return Success;
+    }
+};
+
+template<typename T, typename M>
+class QueuedChannelSlot
+{
+    boost::shared_ptr<QueuedChannelBatch<T, M>> batch_;
+
+  public:
+    QueuedChannelSlot (CallbackQueueInterface* queue,
+                       typename QueuedChannelBatch<T, M>::callback_t fp,
+                       T* obj)
+      : batch_ (boost::make_shared<QueuedChannelBatch<T, M>> (queue, fp, obj))
+    {
+    }
+
+    void
+    operator() (boost::asio::ip::udp::endpoint endpoint,
+                uint16_t comp_id,
+                uint16_t msg_type,
+                std::shared_ptr<const M> msg) const
+    {
+      batch_->push (endpoint, comp_id, msg_type, msg);
+    }
+};
+
+template<typename Signal, typename T, typename M>
+boost::signals2::connection
+connect_queued (Signal& signal,
+                CallbackQueueInterface* queue,
+                void (T::*fp) (boost::asio::ip::udp::endpoint const&, uint16_t, uint16_t, M const&),
+                T* obj)
+{
+  return signal.connect (QueuedChannelSlot<T, M> (queue, fp, obj));
+}
+
 #endif
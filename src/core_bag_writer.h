@@ -0,0 +1,331 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_BAG_WRITER_H__
+#define __CORE_BAG_WRITER_H__
+
+#include "core_includes.h"
+
+#include "core_metrics.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+
+/*
+ * Writes messages to a bag from a background thread, so that logging never
+ * waits for the disk in the callbacks of the core.
+ *
+ * Producers push to an intrusive lock-free MPSC queue (Vyukov) and only take
+ * the mutex to wake the writer when it is sleeping. The writer drains
+ * everything available on each wake up. The queue is bounded: when it is
+ * full (give or take one message per concurrent producer), producers wait
+ * for the writer, as dropping messages from the official log is not
+ * acceptable.
+ */
+class BagWriter
+  : boost::noncopyable
+{
+    typedef std::chrono::steady_clock clock;
+
+    struct Item
+    {
+      std::atomic<Item*> next;
+      clock::time_point enqueued;
+      string topic;
+      Time time;
+
+      Item()
+        : next (nullptr)
+      {
+      }
+
+      virtual ~Item()
+      {
+      }
+
+      virtual void
+      write (rosbag::Bag& bag)
+      {
+      }
+    };
+
+    template<typename M>
+    struct MsgItem
+      : public Item
+    {
+      M msg;
+
+      virtual void
+      write (rosbag::Bag& bag)
+      {
+        bag.write (topic, time, msg);
+      }
+    };
+
+    rosbag::Bag bag_;
+    const size_t capacity_;
+    Histogram& enqueue_time_;
+    Histogram& write_latency_;
+
+    // Queue
+    std::atomic<Item*> head_;
+    Item* tail_;
+    Item stub_;
+    std::atomic<size_t> depth_;
+
+    // Wake ups and back pressure
+    std::mutex mutex_;
+    std::condition_variable writer_cv_;
+    std::condition_variable flushed_cv_;
+    std::condition_variable producers_cv_;
+    std::atomic<bool> writer_sleeping_;
+    std::atomic<size_t> producers_waiting_;
+    std::atomic<uint64_t> enqueued_;
+    uint64_t written_;
+    bool stop_;
+
+    // Statistics
+    std::atomic<size_t> max_depth_;
+    std::atomic<int64_t> max_latency_ns_;
+    std::atomic<int64_t> total_latency_ns_;
+    std::atomic<uint64_t> written_count_;
+
+    std::thread thread_;
+
+    void
+    push (Item* item)
+    {
+      item->next.store (nullptr, std::memory_order_relaxed);
+      Item* prev = head_.exchange (item, std::memory_order_acq_rel);
+      prev->next.store (item, std::memory_order_release);
+    }
+
+    Item*
+    pop()
+    {
+      Item* tail = tail_;
+      Item* next = tail->next.load (std::memory_order_acquire);
+      if (tail == &stub_) {
+        if (! next) {
+          return nullptr;
+        }
+        tail_ = next;
+        tail = next;
+        next = next->next.load (std::memory_order_acquire);
+      }
+      if (next) {
+        tail_ = next;
+        return tail;
+      }
+      if (tail != head_.load (std::memory_order_acquire)) {
+        // A producer is between exchange and store, retry later
+        return nullptr;
+      }
+      push (&stub_);
+      next = tail->next.load (std::memory_order_acquire);
+      if (next) {
+        tail_ = next;
+        return tail;
+      }
+      return nullptr;
+    }
+
+    void
+    enqueue (Item* item)
+    {
+      ScopedLatency enqueue_latency (enqueue_time_);
+      item->enqueued = clock::now();
+
+      if (depth_.load() >= capacity_) {
+        ROS_WARN_STREAM_THROTTLE (1, "Log writer queue is full, waiting for the disk");
+        std::unique_lock<std::mutex> lock (mutex_);
+        ++producers_waiting_;
+        producers_cv_.wait (lock, [this] () { return (depth_.load() < capacity_) || stop_; });
+        --producers_waiting_;
+      }
+
+      // Counted before it is visible, so that the writer never underflows
+      ++enqueued_;
+      size_t depth = ++depth_;
+      push (item);
+
+      size_t max_depth = max_depth_.load (std::memory_order_relaxed);
+      while ( (depth > max_depth)
+              && ! max_depth_.compare_exchange_weak (max_depth, depth, std::memory_order_relaxed)) {
+      }
+
+      if (writer_sleeping_.load()) {
+        std::lock_guard<std::mutex> lock (mutex_);
+        writer_cv_.notify_one();
+      }
+    }
+
+    void
+    run()
+    {
+      while (true) {
+        size_t n = 0;
+        while (Item* item = pop()) {
+          try {
+            item->write (bag_);
+          }
+          catch (std::exception const& e) {
+            ROS_ERROR_STREAM ("Failed to write to log on " << item->topic << ": " << e.what());
+          }
+
+          clock::duration elapsed = clock::now() - item->enqueued;
+          write_latency_.record (elapsed);
+          int64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds> (elapsed).count();
+          total_latency_ns_.fetch_add (latency, std::memory_order_relaxed);
+          int64_t max_latency = max_latency_ns_.load (std::memory_order_relaxed);
+          while ( (latency > max_latency)
+                  && ! max_latency_ns_.compare_exchange_weak (max_latency, latency, std::memory_order_relaxed)) {
+          }
+          written_count_.fetch_add (1, std::memory_order_relaxed);
+
+          delete item;
+          --depth_;
+          ++n;
+        }
+
+        std::unique_lock<std::mutex> lock (mutex_);
+        written_ += n;
+        if (n) {
+          flushed_cv_.notify_all();
+          if (producers_waiting_.load()) {
+            producers_cv_.notify_all();
+          }
+        }
+        if (stop_ && (written_ == enqueued_.load())) {
+          break;
+        }
+        writer_sleeping_.store (true);
+        if (depth_.load() == 0) {
+          writer_cv_.wait_for (lock, std::chrono::milliseconds (100));
+        }
+        writer_sleeping_.store (false);
+      }
+    }
+
+  public:
+    BagWriter (string const& file_name,
+               size_t capacity,
+               Histogram& enqueue_time,
+               Histogram& write_latency)
+      : capacity_ (capacity)
+      , enqueue_time_ (enqueue_time)
+      , write_latency_ (write_latency)
+      , head_ (&stub_)
+      , tail_ (&stub_)
+      , depth_ (0)
+      , writer_sleeping_ (false)
+      , producers_waiting_ (0)
+      , enqueued_ (0)
+      , written_ (0)
+      , stop_ (false)
+      , max_depth_ (0)
+      , max_latency_ns_ (0)
+      , total_latency_ns_ (0)
+      , written_count_ (0)
+    {
+      bag_.open (file_name, rosbag::bagmode::Write);
+      thread_ = std::thread (&BagWriter::run, this);
+    }
+
+    ~BagWriter()
+    {
+      {
+        std::lock_guard<std::mutex> lock (mutex_);
+        stop_ = true;
+        writer_cv_.notify_all();
+        producers_cv_.notify_all();
+      }
+      thread_.join();
+      bag_.close();
+
+      ROS_INFO_STREAM ("Log writer wrote " << written_count_.load()
+                       << " messages, max queue depth " << max_depth_.load()
+                       << ", max latency " << (max_latency_ns_.load() / 1e6) << " ms");
+    }
+
+    template<typename M>
+    void
+    write (string const& topic,
+           Time const& time,
+           M const& msg)
+    {
+      MsgItem<M>* item = new MsgItem<M>();
+      item->topic = topic;
+      item->time = time;
+      item->msg = msg;
+      enqueue (item);
+    }
+
+    /*
+     * Waits until everything written before this call is in the bag.
+     */
+    void
+    flush()
+    {
+      std::unique_lock<std::mutex> lock (mutex_);
+      uint64_t target = enqueued_.load();
+      writer_cv_.notify_one();
+      flushed_cv_.wait (lock, [this, target] () { return written_ >= target; });
+    }
+
+    size_t
+    depth() const
+    {
+      return depth_.load (std::memory_order_relaxed);
+    }
+
+    size_t
+    max_depth() const
+    {
+      return max_depth_.load (std::memory_order_relaxed);
+    }
+
+    uint64_t
+    written_count() const
+    {
+      return written_count_.load (std::memory_order_relaxed);
+    }
+
+    Duration
+    max_latency() const
+    {
+      return Duration().fromNSec (max_latency_ns_.load (std::memory_order_relaxed));
+    }
+
+    Duration
+    mean_latency() const
+    {
+      uint64_t count = written_count_.load (std::memory_order_relaxed);
+      if (count == 0) {
+        return Duration();
+      }
+      return Duration().fromNSec (total_latency_ns_.load (std::memory_order_relaxed) / count);
+    }
+};
+
+#endif
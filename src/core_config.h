@@ -0,0 +1,113 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_CONFIG_H__
+#define __CORE_CONFIG_H__
+
+#include "core_includes.h"
+
+
+
+struct CoreConfig {
+  string rsbb_host;
+  string rsbb_cypher;
+  string log_dir;
+  size_t log_queue_size;
+  Duration allowed_skew;
+  Duration after_stop_duration;
+  size_t display_log_size;
+  size_t display_log_capacity;
+  Duration gui_heartbeat;
+  Duration beacon_min_interval;
+  Duration devices_settle_time;
+  string benchmarks_file;
+  string passwords_file;
+  string schedule_file;
+
+  CoreConfig()
+    : rsbb_host (param_direct<string> ("~rsbb_host", "10.255.255.255"))
+    , rsbb_cypher (param_direct<string> ("~rsbb_cypher", "aes-128-cbc"))
+    , log_dir (param_direct<string> ("~log_dir", "."))
+    , log_queue_size (param_direct<int> ("~log_queue_size", 10000))
+    , allowed_skew (param_direct<double> ("~allowed_skew", 0.5))
+    , after_stop_duration (param_direct<double> ("~after_stop_duration", 120.0))
+    , display_log_size (param_direct<int> ("~display_log_size", 3000))
+    , display_log_capacity (max<size_t> (display_log_size, param_direct<int> ("~display_log_capacity", 65536)))
+    , gui_heartbeat (param_direct<double> ("~gui_heartbeat", 1.0))
+    , beacon_min_interval (param_direct<double> ("~beacon_min_interval", 0.05))
+    , devices_settle_time (param_direct<double> ("~devices_settle_time", 1.0))
+    , benchmarks_file (param_direct<string> ("~benchmarks_file", "benchmarks.yaml"))
+    , passwords_file (param_direct<string> ("~passwords_file", "passwords.yaml"))
+    , schedule_file (param_direct<string> ("~schedule_file", "schedule.yaml"))
+  {
+  }
+};
+
+
+
+/*
+ * Holds the configuration read from the parameter server, so that hot
+ * paths never contact the master. The parameters are read again when
+ * /core/reload_config is called, and the new snapshot replaces the old one
+ * atomically. Old snapshots are kept alive, as readers may still hold
+ * references to them and reloads are rare.
+ */
+class CoreConfigSnapshot
+  : boost::noncopyable
+{
+    std::mutex reload_mutex_;
+    list<unique_ptr<const CoreConfig>> snapshots_;
+    std::atomic<const CoreConfig*> current_;
+
+    ServiceServer reload_srv_;
+
+    bool
+    reload_callback (std_srvs::Empty::Request& req,
+                     std_srvs::Empty::Response& res)
+    {
+      reload();
+      return true;
+    }
+
+  public:
+    CoreConfigSnapshot (NodeHandle& nh)
+      : current_ (nullptr)
+      , reload_srv_ (nh.advertiseService ("/core/reload_config", &CoreConfigSnapshot::reload_callback, this))
+    {
+      reload();
+    }
+
+    void
+    reload()
+    {
+      std::lock_guard<std::mutex> lock (reload_mutex_);
+      snapshots_.push_back (unique_ptr<const CoreConfig> (new CoreConfig()));
+      current_.store (snapshots_.back().get(), std::memory_order_release);
+
+      ROS_INFO ("Configuration loaded");
+    }
+
+    CoreConfig const&
+    get() const
+    {
+      return * (current_.load (std::memory_order_acquire));
+    }
+};
+
+#endif
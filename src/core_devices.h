@@ -0,0 +1,259 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_DEVICES_H__
+#define __CORE_DEVICES_H__
+
+#include "core_includes.h"
+
+#include <condition_variable>
+#include <thread>
+
+#include "core_config.h"
+
+
+
+/*
+ * Sends commands to the home automation devices from a background thread,
+ * so that zones never wait for the devices node.
+ *
+ * Each device holds at most one command in flight and one pending. A new
+ * command replaces the pending one, and is dropped if it asks for the value
+ * in flight or for the value set less than ~devices_settle_time ago, as
+ * robots repeat their request until the devices state reports it.
+ *
+ * The completion of each command is posted to the queue given with it.
+ * Completions still not posted for an owner are dropped by cancel().
+ */
+class CoreDevices
+  : boost::noncopyable
+{
+  public:
+    enum device_t {
+      SWITCH_1,
+      SWITCH_2,
+      SWITCH_3,
+      BLINDS,
+      DIMMER,
+      DEVICES_COUNT
+    };
+
+    typedef boost::function<void (bool ok, uint8_t value, Duration const& latency)> completion_t;
+
+  private:
+    struct Command {
+      uint8_t value;
+      Time queued;
+      CallbackQueueInterface* queue;
+      uint64_t owner;
+      completion_t completion;
+    };
+
+    struct Slot {
+      bool pending;
+      Command pending_command;
+      bool in_flight;
+      Command in_flight_command;
+      bool done;
+      uint8_t done_value;
+      Time done_time;
+
+      Slot()
+        : pending (false)
+        , in_flight (false)
+        , done (false)
+        , done_value (0)
+      {
+      }
+    };
+
+    CoreConfigSnapshot& config_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    Slot slots_[DEVICES_COUNT];
+    bool stop_;
+
+    std::thread thread_;
+
+    static bool
+    call (device_t device,
+          uint8_t value)
+    {
+      switch (device) {
+        case SWITCH_1:
+        case SWITCH_2:
+        case SWITCH_3: {
+            roah_devices::Bool b;
+            b.request.data = value;
+            return call_service ("/devices/" + name (device) + "/set", b);
+          }
+        case BLINDS:
+        case DIMMER: {
+            roah_devices::Percentage p;
+            p.request.data = value;
+            return call_service ("/devices/" + name (device) + "/set", p);
+          }
+        default:
+          return false;
+      }
+    }
+
+    bool
+    next (device_t& device)
+    {
+      for (unsigned d = 0; d < DEVICES_COUNT; ++d) {
+        if (slots_[d].pending && ! slots_[d].in_flight) {
+          device = static_cast<device_t> (d);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void
+    run()
+    {
+      std::unique_lock<std::mutex> lock (mutex_);
+      while (true) {
+        device_t device;
+        cv_.wait (lock, [this, &device] () { return stop_ || next (device); });
+        if (stop_) {
+          return;
+        }
+
+        Slot& slot = slots_[device];
+        slot.pending = false;
+        slot.in_flight = true;
+        slot.in_flight_command = move (slot.pending_command);
+        uint8_t value = slot.in_flight_command.value;
+
+        lock.unlock();
+        bool ok = call (device, value);
+        Time now = Time::now();
+        lock.lock();
+
+        slot.in_flight = false;
+        if (ok) {
+          slot.done = true;
+          slot.done_value = value;
+          slot.done_time = now;
+        }
+
+        Command& c = slot.in_flight_command;
+        if (c.completion) {
+          c.queue->addCallback (boost::make_shared<roah_rsbb::CallbackItem> (boost::bind (c.completion, ok, value, now - c.queued)),
+                                c.owner);
+          c.completion.clear();
+        }
+      }
+    }
+
+  public:
+    CoreDevices (CoreConfigSnapshot& config)
+      : config_ (config)
+      , stop_ (false)
+    {
+      thread_ = std::thread (&CoreDevices::run, this);
+    }
+
+    ~CoreDevices()
+    {
+      {
+        std::lock_guard<std::mutex> lock (mutex_);
+        stop_ = true;
+        cv_.notify_all();
+      }
+      thread_.join();
+    }
+
+    static string
+    name (device_t device)
+    {
+      switch (device) {
+        case SWITCH_1:
+          return "switch_1";
+        case SWITCH_2:
+          return "switch_2";
+        case SWITCH_3:
+          return "switch_3";
+        case BLINDS:
+          return "blinds";
+        case DIMMER:
+          return "dimmer";
+        default:
+          return "unknown";
+      }
+    }
+
+    /*
+     * Returns false if the command was dropped as a duplicate.
+     */
+    bool
+    set (device_t device,
+         uint8_t value,
+         CallbackQueueInterface* queue,
+         uint64_t owner,
+         completion_t const& completion)
+    {
+      Time now = Time::now();
+      Duration settle_time = config_.get().devices_settle_time;
+
+      std::lock_guard<std::mutex> lock (mutex_);
+      Slot& slot = slots_[device];
+
+      if (slot.in_flight && (slot.in_flight_command.value == value)) {
+        slot.pending = false;
+        return false;
+      }
+      if (slot.pending && (slot.pending_command.value == value)) {
+        return false;
+      }
+      if ( (! slot.in_flight) && (! slot.pending)
+           && slot.done && (slot.done_value == value)
+           && ( (now - slot.done_time) < settle_time)) {
+        return false;
+      }
+
+      slot.pending = true;
+      slot.pending_command.value = value;
+      slot.pending_command.queued = now;
+      slot.pending_command.queue = queue;
+      slot.pending_command.owner = owner;
+      slot.pending_command.completion = completion;
+      cv_.notify_all();
+      return true;
+    }
+
+    void
+    cancel (uint64_t owner)
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      for (Slot& slot : slots_) {
+        if (slot.pending && (slot.pending_command.owner == owner)) {
+          slot.pending_command.completion.clear();
+        }
+        if (slot.in_flight && (slot.in_flight_command.owner == owner)) {
+          slot.in_flight_command.completion.clear();
+        }
+      }
+    }
+};
+
+#endif
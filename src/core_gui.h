@@ -28,17 +28,39 @@
 
 
 
+/*
+ * Publishes the state of the core for the GUI plugins. Each zone has its
+ * own topics, listed in /core/state, so that a client only receives the
+ * zone it shows. /core/to_gui still carries everything in one message.
+ * The state topics are latched and only published on changes; /core/state
+ * and /core/to_gui also every ~gui_heartbeat, so clients can detect a lost
+ * core. Each entry of the display texts is published once on the log topic
+ * of its zone, and /core/log_backlog returns the newest ones.
+ */
 class CoreGui
   : boost::noncopyable
 {
+    struct ZonePublisher {
+      Publisher pub;
+      Publisher log_pub;
+      vector<uint8_t> last_serialized;
+    };
+
     CoreSharedState& ss_;
     CorePublicChannel& public_channel_;
     CoreZoneManager& zone_manager_;
 
     Publisher pub_;
+    Publisher state_pub_;
     Timer pub_timer_;
+    Time last_pub_time_;
+    vector<uint8_t> last_state_serialized_;
+    map<string, ZonePublisher> zone_pubs_;
+    set<string> zone_topics_;
+    vector<roah_rsbb::LogEntries> log_;
 
-    ServiceServer set_score_srv_;
+    ServiceServer log_backlog_srv_;
+    ServiceServer set_scores_srv_;
     ServiceServer manual_operation_complete_srv_;
     ServiceServer omf_complete_srv_;
     ServiceServer omf_damaged_srv_;
@@ -50,49 +72,225 @@ class CoreGui
     ServiceServer previous_srv_;
     ServiceServer next_srv_;
 
+    template<typename M>
+    static bool
+    changed (M const& msg,
+             vector<uint8_t>& last_serialized)
+    {
+      uint32_t length = serialization::serializationLength (msg);
+      vector<uint8_t> serialized (length);
+      serialization::OStream stream (serialized.data(), length);
+      serialization::serialize (stream, msg);
+
+      if (serialized == last_serialized) {
+        return false;
+      }
+      last_serialized.swap (serialized);
+      return true;
+    }
+
+    // Zone names are free text, so they are mapped to unique valid names
+    string
+    zone_topic (string const& zone)
+    {
+      string name;
+      for (char c : zone) {
+        name += isalnum (static_cast<unsigned char> (c)) ? c : '_';
+      }
+      if (name.empty() || ! isalpha (static_cast<unsigned char> (name[0]))) {
+        name = "zone_" + name;
+      }
+      string topic = "/core/zones/" + name;
+      for (unsigned i = 2; zone_topics_.count (topic); ++i) {
+        topic = "/core/zones/" + name + "_" + to_string (i);
+      }
+      zone_topics_.insert (topic);
+      return topic;
+    }
+
+    // Returns true if any zone changed, publishing those that did
+    bool
+    publish_zones (vector<roah_rsbb::ZoneState> const& zones,
+                   vector<roah_rsbb::ZoneTopic>& topics)
+    {
+      bool any_changed = false;
+      map<string, ZonePublisher> zone_pubs;
+      for (roah_rsbb::ZoneState const& zone : zones) {
+        ZonePublisher& zp = zone_pubs[zone.zone];
+        auto old = zone_pubs_.find (zone.zone);
+        if (old != zone_pubs_.end()) {
+          zp = std::move (old->second);
+        }
+        else {
+          string topic = zone_topic (zone.zone);
+          zp.pub = ss_.nh.advertise<roah_rsbb::ZoneState> (topic + "/state", 1, true);
+          zp.log_pub = ss_.nh.advertise<roah_rsbb::LogEntries> (topic + "/log", 100);
+          any_changed = true;
+        }
+
+        if (changed (zone, zp.last_serialized)) {
+          zp.pub.publish (zone);
+          any_changed = true;
+        }
+
+        topics.emplace_back();
+        topics.back().zone = zone.zone;
+        topics.back().topic = zp.pub.getTopic();
+        topics.back().log_topic = zp.log_pub.getTopic();
+      }
+      for (auto const& old : zone_pubs_) {
+        if (! zone_pubs.count (old.first)) {
+          string topic = old.second.pub.getTopic();
+          zone_topics_.erase (topic.substr (0, topic.rfind ('/')));
+          any_changed = true;
+        }
+      }
+      // Publishers of removed zones are shut down here
+      zone_pubs_.swap (zone_pubs);
+      return any_changed;
+    }
+
+    void
+    publish_log()
+    {
+      CoreZoneManager::Zones zones = zone_manager_.zones();
+      for (auto const& zone : *zones) {
+        if (! zone.second) {
+          continue;
+        }
+        zone.second->take_log (log_);
+        auto zp = zone_pubs_.find (zone.second->name());
+        if (zp != zone_pubs_.end()) {
+          for (roah_rsbb::LogEntries const& entries : log_) {
+            zp->second.log_pub.publish (entries);
+          }
+        }
+        log_.clear();
+      }
+    }
+
     void
     transmit (const TimerEvent& = TimerEvent())
     {
       Time now = Time::now();
+      auto build_start = std::chrono::steady_clock::now();
 
       // ROS_DEBUG ("Transmitting CoreToGui message");
 
-      auto msg = boost::make_shared<roah_rsbb::CoreToGui>();
-      msg->clock = now;
-      msg->status = ss_.status;
-      msg->addr = public_channel_.host();
-      msg->port = to_string (public_channel_.port());
-      ss_.active_robots.msg (msg->active_robots);
-      zone_manager_.msg (now, msg->zones);
+      auto state = boost::make_shared<roah_rsbb::CoreState>();
+      state->addr = public_channel_.host();
+      state->port = to_string (public_channel_.port());
+      ss_.active_robots.msg (state->active_robots);
 
-      msg->tablet_last_beacon = ss_.last_tablet_time;
-      msg->tablet_display_map = ss_.tablet_display_map;
+      std::unique_lock<std::mutex> lock (ss_.mutex);
+      state->status = ss_.status;
+      state->tablet_last_beacon = ss_.last_tablet_time;
+      state->tablet_display_map = ss_.tablet_display_map;
       if (ss_.last_tablet) {
-        msg->tablet_call_time = roah_rsbb::proto_to_ros_time (ss_.last_tablet->last_call());
-        msg->tablet_position_time = roah_rsbb::proto_to_ros_time (ss_.last_tablet->last_pos());
-        msg->tablet_position_x = ss_.last_tablet->x();
-        msg->tablet_position_y = ss_.last_tablet->y();
+        state->tablet_call_time = roah_rsbb::proto_to_ros_time (ss_.last_tablet->last_call());
+        state->tablet_position_time = roah_rsbb::proto_to_ros_time (ss_.last_tablet->last_pos());
+        state->tablet_position_x = ss_.last_tablet->x();
+        state->tablet_position_y = ss_.last_tablet->y();
       }
       else {
-        msg->tablet_call_time = TIME_MIN;
-        msg->tablet_position_time = TIME_MIN;
-        msg->tablet_position_x = 0;
-        msg->tablet_position_y = 0;
+        state->tablet_call_time = TIME_MIN;
+        state->tablet_position_time = TIME_MIN;
+        state->tablet_position_x = 0;
+        state->tablet_position_y = 0;
+      }
+      lock.unlock();
+
+      auto msg = boost::make_shared<roah_rsbb::CoreToGui>();
+      zone_manager_.msg (now, msg->zones);
+      bool zones_changed = publish_zones (msg->zones, state->zones);
+      publish_log();
+
+      // The clock is left out of the comparison, clients extrapolate it
+      // from the reception time.
+      bool state_changed = changed (*state, last_state_serialized_);
+      ss_.metrics.gui_build.record (std::chrono::steady_clock::now() - build_start);
+      if (! (state_changed || zones_changed
+             || ( (now - last_pub_time_) >= ss_.config.get().gui_heartbeat))) {
+        return;
       }
+      state->clock = now;
+      state_pub_.publish (state);
 
+      msg->clock = now;
+      msg->status = state->status;
+      msg->addr = state->addr;
+      msg->port = state->port;
+      msg->active_robots = state->active_robots;
+      msg->tablet_last_beacon = state->tablet_last_beacon;
+      msg->tablet_display_map = state->tablet_display_map;
+      msg->tablet_call_time = state->tablet_call_time;
+      msg->tablet_position_time = state->tablet_position_time;
+      msg->tablet_position_x = state->tablet_position_x;
+      msg->tablet_position_y = state->tablet_position_y;
+      ss_.metrics.gui_size.record (serialization::serializationLength (*msg));
       pub_.publish (msg);
+      last_pub_time_ = now;
     }
 
     bool
-    set_score_callback (roah_rsbb::ZoneScore::Request& req,
-                        roah_rsbb::ZoneScore::Response& res)
+    log_backlog_callback (roah_rsbb::LogBacklog::Request& req,
+                          roah_rsbb::LogBacklog::Response& res)
     {
       Zone::Ptr zone = zone_manager_.get (req.zone);
       if (! zone) {
-        ROS_WARN_STREAM ("set_score_callback: Could not find zone: " << req.zone);
+        ROS_WARN_STREAM ("log_backlog_callback: Could not find zone: " << req.zone);
+        return false;
+      }
+      if (req.stream > roah_rsbb::LogEntries::ONLINE_DATA) {
+        ROS_WARN_STREAM ("log_backlog_callback: Invalid stream: " << static_cast<unsigned> (req.stream));
+        return false;
+      }
+
+      // Served from the last snapshot, the zone thread is not involved
+      zone->backlog (req.stream, res.entries);
+      res.capacity = ss_.config.get().display_log_size;
+      return true;
+    }
+
+    bool
+    set_scores_callback (roah_rsbb::SetScores::Request& req,
+                         roah_rsbb::SetScores::Response& res)
+    {
+      Zone::Ptr zone = zone_manager_.get (req.zone);
+      if (! zone) {
+        ROS_WARN_STREAM ("set_scores_callback: Could not find zone: " << req.zone);
+        return false;
+      }
+
+      // Unlike the other commands, the caller waits for the new version, so
+      // wait for the zone thread to apply the batch. The state is shared, as
+      // the zone may only get to it after we gave up; the batch is then
+      // reported as pending, not as failed.
+      struct Result {
+        std::promise<bool> applied;
+        uint32_t version;
+      };
+      auto result = std::make_shared<Result>();
+      uint32_t schema = req.schema;
+      auto scores = boost::make_shared<vector<roah_rsbb::Score>>();
+      scores->swap (req.scores);
+      Zone* target = zone.get();
+      zone->post ([target, result, schema, scores] () {
+        result->applied.set_value (target->set_scores (schema, *scores, result->version));
+      });
+
+      std::future<bool> applied = result->applied.get_future();
+      if (applied.wait_for (std::chrono::seconds (2)) != std::future_status::ready) {
+        ROS_WARN_STREAM ("set_scores_callback: Scores for zone " << req.zone << " still pending, the zone is busy");
+        res.version = 0;
+        res.pending = true;
+        return true;
+      }
+      if (! applied.get()) {
         return false;
       }
-      zone->set_score (req.score);
+      res.version = result->version;
+      res.pending = false;
       return true;
     }
 
@@ -105,7 +303,9 @@ class CoreGui
         ROS_WARN_STREAM ("manual_operation_complete_callback: Could not find zone: " << req.zone);
         return false;
       }
-      zone->manual_operation_complete(req.manual_operation_result);
+      string result = req.manual_operation_result;
+      Zone* target = zone.get();
+      zone->post ([target, result] () { target->manual_operation_complete (result); });
       return true;
     }
 
@@ -118,7 +318,7 @@ class CoreGui
         ROS_WARN_STREAM ("omf_complete_callback: Could not find zone: " << req.zone);
         return false;
       }
-      zone->omf_complete();
+      zone->post (boost::bind (&Zone::omf_complete, zone.get()));
       return true;
     }
 
@@ -131,7 +331,8 @@ class CoreGui
         ROS_WARN_STREAM ("omf_damaged_callback: Could not find zone: " << req.zone);
         return false;
       }
-      zone->omf_damaged (req.data);
+      uint8_t damaged = req.data;
+      zone->post (boost::bind (&Zone::omf_damaged, zone.get(), damaged));
       return true;
     }
 
@@ -144,7 +345,8 @@ class CoreGui
         ROS_WARN_STREAM ("omf_button_callback: Could not find zone: " << req.zone);
         return false;
       }
-      zone->omf_button (req.data);
+      uint8_t button = req.data;
+      zone->post (boost::bind (&Zone::omf_button, zone.get(), button));
       return true;
     }
 
@@ -157,7 +359,7 @@ class CoreGui
         ROS_WARN_STREAM ("connect_callback: Could not find zone: " << req.zone);
         return false;
       }
-      zone->connect();
+      zone->post (boost::bind (&Zone::connect, zone.get()));
       return true;
     }
 
@@ -170,7 +372,7 @@ class CoreGui
         ROS_WARN_STREAM ("disconnect_callback: Could not find zone: " << req.zone);
         return false;
       }
-      zone->disconnect();
+      zone->post (boost::bind (&Zone::disconnect, zone.get()));
       return true;
     }
 
@@ -183,7 +385,7 @@ class CoreGui
         ROS_WARN_STREAM ("start_callback: Could not find zone: " << req.zone);
         return false;
       }
-      zone->start();
+      zone->post (boost::bind (&Zone::start, zone.get()));
       return true;
     }
 
@@ -196,7 +398,7 @@ class CoreGui
         ROS_WARN_STREAM ("stop_callback: Could not find zone: " << req.zone);
         return false;
       }
-      zone->stop();
+      zone->post (boost::bind (&Zone::stop, zone.get()));
       return true;
     }
 
@@ -209,7 +411,7 @@ class CoreGui
         ROS_WARN_STREAM ("previous_callback: Could not find zone: " << req.zone);
         return false;
       }
-      zone->previous();
+      zone->post (boost::bind (&Zone::previous, zone.get()));
       return true;
     }
 
@@ -222,7 +424,7 @@ class CoreGui
         ROS_WARN_STREAM ("next_callback: Could not find zone: " << req.zone);
         return false;
       }
-      zone->next();
+      zone->post (boost::bind (&Zone::next, zone.get()));
       return true;
     }
 
@@ -234,8 +436,11 @@ class CoreGui
       , public_channel_ (public_channel)
       , zone_manager_ (zone_manager)
       , pub_ (ss_.nh.advertise<roah_rsbb::CoreToGui> ("/core/to_gui", 1, true))
+      , state_pub_ (ss_.nh.advertise<roah_rsbb::CoreState> ("/core/state", 1, true))
       , pub_timer_ (ss_.nh.createTimer (Duration (0.1), &CoreGui::transmit, this))
-      , set_score_srv_ (ss_.nh.advertiseService ("/core/set_score", &CoreGui::set_score_callback, this))
+      , last_pub_time_ (TIME_MIN)
+      , log_backlog_srv_ (ss_.nh.advertiseService ("/core/log_backlog", &CoreGui::log_backlog_callback, this))
+      , set_scores_srv_ (ss_.nh.advertiseService ("/core/set_scores", &CoreGui::set_scores_callback, this))
       , manual_operation_complete_srv_ (ss_.nh.advertiseService ("/core/manual_operation_complete", &CoreGui::manual_operation_complete_callback, this))
       , omf_complete_srv_ (ss_.nh.advertiseService ("/core/omf_switches/complete", &CoreGui::omf_complete_callback, this))
       , omf_damaged_srv_ (ss_.nh.advertiseService ("/core/omf_switches/damaged", &CoreGui::omf_damaged_callback, this))
@@ -20,10 +20,19 @@
 #ifndef __CORE_INCLUDES_H__
 #define __CORE_INCLUDES_H__
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <limits>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <stdexcept>
+#include <unordered_map>
 
 #include <boost/date_time.hpp>
 #include <boost/noncopyable.hpp>
@@ -38,6 +47,7 @@
 
 #include <std_msgs/Empty.h>
 #include <std_msgs/String.h>
+#include <std_msgs/Time.h>
 #include <std_msgs/UInt8.h>
 #include <std_srvs/Empty.h>
 
@@ -49,14 +59,20 @@
 #include <roah_devices/Bool.h>
 #include <roah_devices/DevicesState.h>
 #include <roah_devices/Percentage.h>
+#include <roah_rsbb/CoreMetrics.h>
+#include <roah_rsbb/CoreState.h>
 #include <roah_rsbb/CoreToGui.h>
 #include <roah_rsbb/CoreToPublic.h>
+#include <roah_rsbb/LogBacklog.h>
+#include <roah_rsbb/LogEntries.h>
 #include <roah_rsbb/RobotInfo.h>
+#include <roah_rsbb/Scores.h>
+#include <roah_rsbb/ScoringSchema.h>
+#include <roah_rsbb/SetScores.h>
 #include <roah_rsbb/Zone.h>
 #include <roah_rsbb/ZoneManualOperationResult.h>
 #include <roah_rsbb/ZoneState.h>
 #include <roah_rsbb/ZoneUInt8.h>
-#include <roah_rsbb/ZoneScore.h>
 
 #include <roah_utils.h>
 #include <ros_roah_rsbb.h>
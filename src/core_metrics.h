@@ -0,0 +1,287 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_METRICS_H__
+#define __CORE_METRICS_H__
+
+#include "core_includes.h"
+
+#include <chrono>
+#include <fstream>
+
+
+
+/*
+ * Lock-free histogram with power of two buckets, cheap enough to be
+ * recorded from the hot paths of any thread.
+ */
+class Histogram
+  : boost::noncopyable
+{
+    static const size_t BUCKETS = 65;
+
+    const string name_;
+    const string unit_;
+
+    std::atomic<uint64_t> buckets_[BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+
+    // Only used by the publisher
+    uint64_t last_count_;
+
+    static size_t
+    bucket (uint64_t value)
+    {
+      return value ? (64 - __builtin_clzll (value)) : 0;
+    }
+
+  public:
+    Histogram (string const& name,
+               string const& unit)
+      : name_ (name)
+      , unit_ (unit)
+      , count_ (0)
+      , sum_ (0)
+      , min_ (numeric_limits<uint64_t>::max())
+      , max_ (0)
+      , last_count_ (0)
+    {
+      for (auto& b : buckets_) {
+        b.store (0, std::memory_order_relaxed);
+      }
+    }
+
+    string const&
+    name() const
+    {
+      return name_;
+    }
+
+    void
+    record (uint64_t value)
+    {
+      buckets_[bucket (value)].fetch_add (1, std::memory_order_relaxed);
+      count_.fetch_add (1, std::memory_order_relaxed);
+      sum_.fetch_add (value, std::memory_order_relaxed);
+
+      uint64_t min = min_.load (std::memory_order_relaxed);
+      while ( (value < min)
+              && ! min_.compare_exchange_weak (min, value, std::memory_order_relaxed)) {
+      }
+      uint64_t max = max_.load (std::memory_order_relaxed);
+      while ( (value > max)
+              && ! max_.compare_exchange_weak (max, value, std::memory_order_relaxed)) {
+      }
+    }
+
+    // Negative durations, from clock adjustments, are recorded as zero
+    void
+    record (Duration const& d)
+    {
+      record (static_cast<uint64_t> (max<int64_t> (0, d.toNSec())));
+    }
+
+    void
+    record (std::chrono::steady_clock::duration const& d)
+    {
+      record (static_cast<uint64_t> (max<int64_t> (0, std::chrono::duration_cast<std::chrono::nanoseconds> (d).count())));
+    }
+
+    void
+    msg (roah_rsbb::Histogram& msg)
+    {
+      msg.name = name_;
+      msg.unit = unit_;
+      msg.buckets.clear();
+      for (size_t i = 0; i < BUCKETS; ++i) {
+        msg.buckets.push_back (buckets_[i].load (std::memory_order_relaxed));
+      }
+      while ( (! msg.buckets.empty()) && (msg.buckets.back() == 0)) {
+        msg.buckets.pop_back();
+      }
+      msg.count = count_.load (std::memory_order_relaxed);
+      msg.period_count = msg.count - last_count_;
+      last_count_ = msg.count;
+      msg.sum = sum_.load (std::memory_order_relaxed);
+      msg.min = msg.count ? min_.load (std::memory_order_relaxed) : 0;
+      msg.max = max_.load (std::memory_order_relaxed);
+    }
+
+    // Upper bound of the bucket where the percentile falls, capped by max
+    uint64_t
+    percentile (double p) const
+    {
+      uint64_t count = count_.load (std::memory_order_relaxed);
+      uint64_t max = max_.load (std::memory_order_relaxed);
+      uint64_t rank = static_cast<uint64_t> (p * count);
+      uint64_t acc = 0;
+      for (size_t i = 0; i < (BUCKETS - 1); ++i) {
+        acc += buckets_[i].load (std::memory_order_relaxed);
+        if (acc > rank) {
+          return (i == 0) ? 0 : std::min (uint64_t (1) << i, max);
+        }
+      }
+      return max;
+    }
+
+    void
+    dump (ostream& o) const
+    {
+      uint64_t count = count_.load();
+      o << name_ << ":" << endl;
+      o << "  unit: " << unit_ << endl;
+      o << "  count: " << count << endl;
+      if (count) {
+        o << "  mean: " << (sum_.load() / count) << endl;
+        o << "  min: " << min_.load() << endl;
+        o << "  p50: " << percentile (0.5) << endl;
+        o << "  p90: " << percentile (0.9) << endl;
+        o << "  p99: " << percentile (0.99) << endl;
+        o << "  max: " << max_.load() << endl;
+      }
+      o << "  buckets: [";
+      size_t last = BUCKETS;
+      while ( (last > 0) && (buckets_[last - 1].load() == 0)) {
+        --last;
+      }
+      for (size_t i = 0; i < last; ++i) {
+        o << (i ? ", " : "") << buckets_[i].load();
+      }
+      o << "]" << endl;
+    }
+};
+
+
+
+class ScopedLatency
+  : boost::noncopyable
+{
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+
+  public:
+    ScopedLatency (Histogram& histogram)
+      : histogram_ (histogram)
+      , start_ (std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedLatency()
+    {
+      histogram_.record (std::chrono::steady_clock::now() - start_);
+    }
+};
+
+
+
+/*
+ * Histograms of the hot paths of the core, published periodically on
+ * /core/metrics and dumped to the log directory at shutdown.
+ */
+class CoreMetrics
+  : boost::noncopyable
+{
+    std::mutex mutex_;
+    vector<Histogram*> all_;
+    Time last_pub_time_;
+
+    Publisher pub_;
+    Timer pub_timer_;
+
+    void
+    transmit (const TimerEvent& = TimerEvent())
+    {
+      Time now = Time::now();
+
+      auto msg = boost::make_shared<roah_rsbb::CoreMetrics>();
+      msg->stamp = now;
+
+      std::lock_guard<std::mutex> lock (mutex_);
+      msg->period = now - last_pub_time_;
+      last_pub_time_ = now;
+      msg->histograms.resize (all_.size());
+      for (size_t i = 0; i < all_.size(); ++i) {
+        all_[i]->msg (msg->histograms[i]);
+      }
+
+      pub_.publish (msg);
+    }
+
+  public:
+    // From a RobotState datagram arriving to the BenchmarkState that acknowledges it being sent
+    Histogram robot_state_ack;
+    Histogram gui_build;
+    Histogram gui_size;
+    Histogram public_build;
+    // From when a timeout should fire to when it runs in the zone thread
+    Histogram timeout_lateness;
+    // From a deadline to the scheduler thread waking up for it
+    Histogram scheduler_jitter;
+    Histogram bmbox_callback;
+    // Time spent by callers of RsbbLog, including back pressure
+    Histogram log_enqueue;
+    // From RsbbLog to the bag
+    Histogram log_write;
+
+    CoreMetrics (NodeHandle& nh)
+      : last_pub_time_ (Time::now())
+      , pub_ (nh.advertise<roah_rsbb::CoreMetrics> ("/core/metrics", 1, true))
+      , robot_state_ack ("robot_state_ack", "ns")
+      , gui_build ("gui_build", "ns")
+      , gui_size ("gui_size", "bytes")
+      , public_build ("public_build", "ns")
+      , timeout_lateness ("timeout_lateness", "ns")
+      , scheduler_jitter ("scheduler_jitter", "ns")
+      , bmbox_callback ("bmbox_callback", "ns")
+      , log_enqueue ("log_enqueue", "ns")
+      , log_write ("log_write", "ns")
+    {
+      all_ = { &robot_state_ack, &gui_build, &gui_size, &public_build,
+               &timeout_lateness, &scheduler_jitter, &bmbox_callback, &log_enqueue, &log_write
+             };
+
+      pub_timer_ = nh.createTimer (Duration (param_direct<double> ("~metrics_period", 5.0)), &CoreMetrics::transmit, this);
+    }
+
+    ~CoreMetrics()
+    {
+      pub_timer_.stop();
+    }
+
+    void
+    dump (string const& file_name)
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      ofstream o (file_name);
+      for (Histogram const* h : all_) {
+        h->dump (o);
+      }
+      if (o) {
+        ROS_INFO_STREAM ("Metrics written to " << file_name);
+      }
+      else {
+        ROS_ERROR_STREAM ("Failed to write metrics to " << file_name);
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_PORT_POOL_H__
+#define __CORE_PORT_POOL_H__
+
+#include "core_includes.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+
+/*
+ * Ports for the private channels, from a fixed range that is checked when
+ * the core starts. Each executing robot benchmark leases one, and returns
+ * it when it ends. Returned ports go to the back of the queue, so a port is
+ * not reused while late packets for the previous robot may still arrive.
+ */
+class CorePortPool
+  : boost::noncopyable
+{
+    std::mutex mutex_;
+    deque<unsigned short> free_;
+
+    static bool
+    available (unsigned short port)
+    {
+      int fd = socket (AF_INET, SOCK_DGRAM, 0);
+      if (fd < 0) {
+        return false;
+      }
+      sockaddr_in addr;
+      memset (&addr, 0, sizeof (addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl (INADDR_ANY);
+      addr.sin_port = htons (port);
+      bool ok = bind (fd, reinterpret_cast<sockaddr*> (&addr), sizeof (addr)) == 0;
+      close (fd);
+      return ok;
+    }
+
+    void
+    release (unsigned short port)
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      free_.push_back (port);
+    }
+
+  public:
+    /*
+     * Throws runtime_error when all ports are in use.
+     */
+    class Lease
+      : boost::noncopyable
+    {
+        CorePortPool* pool_;
+        unsigned short port_;
+
+      public:
+        Lease (CorePortPool& pool)
+          : pool_ (&pool)
+        {
+          std::lock_guard<std::mutex> lock (pool.mutex_);
+          if (pool.free_.empty()) {
+            throw runtime_error ("All private channel ports are in use");
+          }
+          port_ = pool.free_.front();
+          pool.free_.pop_front();
+        }
+
+        ~Lease()
+        {
+          if (pool_) {
+            pool_->release (port_);
+          }
+        }
+
+        unsigned short
+        port() const
+        {
+          return port_;
+        }
+
+        /*
+         * The port could not be used after all, do not return it.
+         */
+        void
+        discard()
+        {
+          ROS_ERROR_STREAM ("Private channel port " << port_ << " removed from the pool");
+          pool_ = nullptr;
+        }
+    };
+
+    CorePortPool (unsigned short first,
+                  unsigned count)
+    {
+      for (unsigned i = 0; i < count; ++i) {
+        unsigned short port = first + i;
+        if (available (port)) {
+          free_.push_back (port);
+        }
+        else {
+          ROS_WARN_STREAM ("Private channel port " << port << " is in use, skipping it");
+        }
+      }
+      if (free_.empty()) {
+        ROS_FATAL_STREAM ("No private channel ports available from " << first);
+        abort_rsbb();
+      }
+    }
+};
+
+#endif
@@ -28,47 +28,149 @@
 
 
 
+/*
+ * The public schedule is built when the schedule is loaded, sorted by time
+ * and with its strings already formatted. The periodic check only looks at
+ * the schedule version and the running event of each zone, and a new
+ * message is published when that changes what is visible. The core time
+ * goes separately on /core/clock every ~gui_heartbeat, unlatched, so a
+ * display never takes its clock from an old message and advances it
+ * locally in between.
+ */
 class CorePublic
   : boost::noncopyable
 {
+    struct ScheduleEntry {
+      Event const* event;
+      roah_rsbb::ScheduleInfo info;
+    };
+
     CoreSharedState& ss_;
     CoreZoneManager& zone_manager_;
 
     Publisher pub_;
     Timer pub_timer_;
+    Publisher clock_pub_;
+    Timer clock_timer_;
 
+    unsigned schedule_version_;
+    vector<ScheduleEntry> schedule_;
+    // Keeps the events referenced by schedule_ alive after a reload
+    vector<shared_ptr<const ZoneEvents>> schedule_events_;
+    unordered_map<Event const*, size_t> schedule_index_;
+    vector<Event const*> running_;
     Time relevant_time_;
+    size_t first_visible_;
 
     void
-    transmit (const TimerEvent& = TimerEvent())
+    build_schedule()
     {
-      Time now = Time::now();
+      schedule_.clear();
+      schedule_events_.clear();
+      schedule_index_.clear();
+      running_.clear();
 
-      auto msg = boost::make_shared<roah_rsbb::CoreToPublic>();
-      msg->clock = to_string (Time (now.sec, 0));
-
-      multimap<Time, roah_rsbb::ScheduleInfo> map;
-      zone_manager_.msg (now, map);
-      for (auto const& i : map) {
-        if (i.second.running) {
-          relevant_time_ = i.first;
-          break;
+      CoreZoneManager::Zones zones = zone_manager_.zones();
+      for (auto const& zone : *zones) {
+        schedule_events_.push_back (zone.second->events());
+        for (auto const& event : *schedule_events_.back()) {
+          ScheduleEntry entry;
+          entry.event = &event.second;
+          entry.info.team = event.second.team;
+          entry.info.benchmark = event.second.benchmark->desc;
+          entry.info.round = event.second.round;
+          entry.info.run = event.second.run;
+          entry.info.time = to_string (event.second.scheduled_time);
+          entry.info.running = false;
+          schedule_.push_back (move (entry));
         }
       }
-      {
-        multimap<Time, roah_rsbb::ScheduleInfo>::iterator i = map.begin();
-        while (i != map.end()) {
-          if (i->first < relevant_time_) {
-            i = map.erase (i);
-          }
-          else {
-            break;
-          }
+      stable_sort (schedule_.begin(), schedule_.end(),
+                   [] (ScheduleEntry const& a, ScheduleEntry const& b) {
+                     return a.event->scheduled_time < b.event->scheduled_time;
+                   });
+
+      for (size_t i = 0; i < schedule_.size(); ++i) {
+        schedule_index_[schedule_[i].event] = i;
+      }
+    }
+
+    bool
+    update_schedule()
+    {
+      bool changed = false;
+
+      unsigned version = ss_.schedule_version.load();
+      if (version != schedule_version_) {
+        schedule_version_ = version;
+        build_schedule();
+        changed = true;
+      }
+
+      // Events of a newer schedule are ignored until it is built
+      vector<Event const*> running;
+      CoreZoneManager::Zones zones = zone_manager_.zones();
+      for (auto const& zone : *zones) {
+        Event const* event = zone.second->running_event();
+        if (event && schedule_index_.count (event)) {
+          running.push_back (event);
+        }
+      }
+      if (running != running_) {
+        for (Event const* event : running_) {
+          schedule_[schedule_index_.at (event)].info.running = false;
+        }
+        // Everything before the first running event is hidden. When nothing
+        // is running the window stays where it was.
+        size_t first_running = schedule_.size();
+        for (Event const* event : running) {
+          size_t i = schedule_index_.at (event);
+          schedule_[i].info.running = true;
+          first_running = min (first_running, i);
         }
+        if (first_running != schedule_.size()) {
+          relevant_time_ = schedule_[first_running].event->scheduled_time;
+        }
+        running_.swap (running);
+        changed = true;
       }
-      for (auto const& i : map) {
-        msg->schedule.push_back (i.second);
+
+      if (changed) {
+        first_visible_ = lower_bound (schedule_.begin(), schedule_.end(), relevant_time_,
+                                      [] (ScheduleEntry const& entry, Time const& time) {
+                                        return entry.event->scheduled_time < time;
+                                      }) - schedule_.begin();
+      }
+      return changed;
+    }
+
+    void
+    check (const TimerEvent& = TimerEvent())
+    {
+      if (update_schedule()) {
+        transmit();
+      }
+    }
+
+    void
+    transmit_clock (const TimerEvent& = TimerEvent())
+    {
+      std_msgs::Time msg;
+      msg.data = Time::now();
+      clock_pub_.publish (msg);
+    }
+
+    void
+    transmit()
+    {
+      auto build_start = std::chrono::steady_clock::now();
+
+      auto msg = boost::make_shared<roah_rsbb::CoreToPublic>();
+      msg->schedule.reserve (schedule_.size() - first_visible_);
+      for (size_t i = first_visible_; i < schedule_.size(); ++i) {
+        msg->schedule.push_back (schedule_[i].info);
       }
+      ss_.metrics.public_build.record (std::chrono::steady_clock::now() - build_start);
 
       pub_.publish (msg);
     }
@@ -79,10 +181,15 @@ class CorePublic
       : ss_ (ss)
       , zone_manager_ (zone_manager)
       , pub_ (ss_.nh.advertise<roah_rsbb::CoreToPublic> ("/core/to_public", 1, true))
-      , pub_timer_ (ss_.nh.createTimer (Duration (0.5), &CorePublic::transmit, this))
+      , clock_pub_ (ss_.nh.advertise<std_msgs::Time> ("/core/clock", 1, false))
+      , schedule_version_ (ss_.schedule_version.load() - 1)
       , relevant_time_ (TIME_MIN)
+      , first_visible_ (0)
     {
+      update_schedule();
       transmit();
+      pub_timer_ = ss_.nh.createTimer (Duration (0.5), &CorePublic::check, this);
+      clock_timer_ = ss_.nh.createTimer (ss_.config.get().gui_heartbeat, &CorePublic::transmit_clock, this);
     }
 };
 
@@ -22,6 +22,9 @@
 
 #include "core_includes.h"
 
+#include <chrono>
+#include <thread>
+
 #include "core_shared_state.h"
 
 
@@ -32,55 +35,88 @@ class CorePublicChannel
 {
     CoreSharedState& ss_;
 
-    Timer beacon_timer_;
+    // Beacon built for beacon_version_, rebuilt only when an input changed
+    roah_rsbb_msgs::RoahRsbbBeacon beacon_;
+    unsigned beacon_version_;
+    // Guarded by the mutex of ss_
+    bool stop_;
+    std::thread beacon_thread_;
 
+    // With the mutex of ss_ locked
     void
-    transmit_beacon (const TimerEvent& = TimerEvent())
+    build_beacon()
     {
-      ROS_DEBUG ("Transmitting beacon");
-
-      roah_rsbb_msgs::RoahRsbbBeacon msg;
+      beacon_.Clear();
       for (auto const& i : ss_.benchmarking_robots) {
-        roah_rsbb_msgs::BenchmarkingTeam* bt = msg.add_benchmarking_teams();
+        roah_rsbb_msgs::BenchmarkingTeam* bt = beacon_.add_benchmarking_teams();
         bt->set_team_name (i.first);
         bt->set_robot_name (i.second.first);
         bt->set_rsbb_port (i.second.second);
       }
 
-      msg.mutable_devices_bell()->set_sec (ss_.last_devices_state->bell.sec);
-      msg.mutable_devices_bell()->set_nsec (ss_.last_devices_state->bell.nsec);
-      msg.set_devices_switch_1 (ss_.last_devices_state->switch_1 != 0);
-      msg.set_devices_switch_2 (ss_.last_devices_state->switch_2 != 0);
-      msg.set_devices_switch_3 (ss_.last_devices_state->switch_3 != 0);
-      msg.set_devices_dimmer (static_cast<uint32_t> (ss_.last_devices_state->dimmer));
-      msg.set_devices_blinds (static_cast<uint32_t> (ss_.last_devices_state->blinds));
+      beacon_.mutable_devices_bell()->set_sec (ss_.last_devices_state->bell.sec);
+      beacon_.mutable_devices_bell()->set_nsec (ss_.last_devices_state->bell.nsec);
+      beacon_.set_devices_switch_1 (ss_.last_devices_state->switch_1 != 0);
+      beacon_.set_devices_switch_2 (ss_.last_devices_state->switch_2 != 0);
+      beacon_.set_devices_switch_3 (ss_.last_devices_state->switch_3 != 0);
+      beacon_.set_devices_dimmer (static_cast<uint32_t> (ss_.last_devices_state->dimmer));
+      beacon_.set_devices_blinds (static_cast<uint32_t> (ss_.last_devices_state->blinds));
 
-      msg.set_tablet_display_map (ss_.tablet_display_map);
+      beacon_.set_tablet_display_map (ss_.tablet_display_map);
       if (ss_.last_tablet) {
-        (* (msg.mutable_tablet_call_time())) = ss_.last_tablet->last_call();
-        (* (msg.mutable_tablet_position_time())) = ss_.last_tablet->last_pos();
-        msg.set_tablet_position_x (ss_.last_tablet->x());
-        msg.set_tablet_position_y (ss_.last_tablet->y());
+        (* (beacon_.mutable_tablet_call_time())) = ss_.last_tablet->last_call();
+        (* (beacon_.mutable_tablet_position_time())) = ss_.last_tablet->last_pos();
+        beacon_.set_tablet_position_x (ss_.last_tablet->x());
+        beacon_.set_tablet_position_y (ss_.last_tablet->y());
       }
       else {
-        msg.mutable_tablet_call_time()->set_sec (0);
-        msg.mutable_tablet_call_time()->set_nsec (0);
-        msg.mutable_tablet_position_time()->set_sec (0);
-        msg.mutable_tablet_position_time()->set_nsec (0);
-        msg.set_tablet_position_x (0);
-        msg.set_tablet_position_y (0);
+        beacon_.mutable_tablet_call_time()->set_sec (0);
+        beacon_.mutable_tablet_call_time()->set_nsec (0);
+        beacon_.mutable_tablet_position_time()->set_sec (0);
+        beacon_.mutable_tablet_position_time()->set_nsec (0);
+        beacon_.set_tablet_position_x (0);
+        beacon_.set_tablet_position_y (0);
       }
-      send (msg);
+      beacon_version_ = ss_.beacon_version;
     }
+
+    /*
+     * Sends the beacon every second, and also as soon as one of its inputs
+     * changes, so robots see the devices and the tablet without waiting for
+     * the next period. Consecutive sends are at least beacon_min_interval
+     * apart.
+     */
     void
-    setup_transmit_beacon (const TimerEvent&)
+    transmit_beacon()
     {
-      transmit_beacon ();
-
-      beacon_timer_.stop();
-      beacon_timer_ = ss_.nh.createTimer (Duration (1, 0), &CorePublicChannel::transmit_beacon, this);
+      typedef std::chrono::steady_clock clock;
 
+      std::unique_lock<std::mutex> lock (ss_.mutex);
+      ss_.beacon_cv.wait_for (lock, std::chrono::seconds (5), [this] () { return stop_; });
+      if (stop_) {
+        return;
+      }
       ss_.status = "OK";
+
+      build_beacon();
+      while (true) {
+        if (ss_.beacon_version != beacon_version_) {
+          build_beacon();
+        }
+        lock.unlock();
+        ROS_DEBUG ("Transmitting beacon");
+        send (beacon_);
+        clock::time_point last_send = clock::now();
+        lock.lock();
+
+        ss_.beacon_cv.wait_until (lock, last_send + std::chrono::seconds (1),
+                                  [this] () { return stop_ || (ss_.beacon_version != beacon_version_); });
+        auto min_interval = std::chrono::nanoseconds (ss_.config.get().beacon_min_interval.toNSec());
+        ss_.beacon_cv.wait_until (lock, last_send + min_interval, [this] () { return stop_; });
+        if (stop_) {
+          return;
+        }
+      }
     }
 
     void
@@ -117,6 +153,13 @@ class CorePublicChannel
       ss_.active_robots.add (msg->team_name(), msg->robot_name(), skew, now);
     }
 
+    static bool
+    same_time (roah_rsbb_msgs::Time const& a,
+               roah_rsbb_msgs::Time const& b)
+    {
+      return (a.sec() == b.sec()) && (a.nsec() == b.nsec());
+    }
+
     void
     receive_tablet_beacon (boost::asio::ip::udp::endpoint endpoint,
                            uint16_t comp_id,
@@ -128,7 +171,15 @@ class CorePublicChannel
                         << ", COMP_ID " << comp_id
                         << ", MSG_TYPE " << msg_type);
 
+      std::lock_guard<std::mutex> lock (ss_.mutex);
       ss_.last_tablet_time = Time::now();
+      if ( (! ss_.last_tablet)
+           || (! same_time (ss_.last_tablet->last_call(), msg->last_call()))
+           || (! same_time (ss_.last_tablet->last_pos(), msg->last_pos()))
+           || (ss_.last_tablet->x() != msg->x())
+           || (ss_.last_tablet->y() != msg->y())) {
+        ss_.beacon_changed();
+      }
       ss_.last_tablet = msg;
     }
 
@@ -137,18 +188,25 @@ class CorePublicChannel
       : roah_rsbb::RosPublicChannel (param_direct<string> ("~rsbb_host", "10.255.255.255"),
                                      param_direct<int> ("~rsbb_port", 6666))
       , ss_ (ss)
-      , beacon_timer_ (ss_.nh.createTimer (Duration (5, 0), &CorePublicChannel::setup_transmit_beacon, this, true))
+      , beacon_version_ (0)
+      , stop_ (false)
     {
       set_rsbb_beacon_callback (&CorePublicChannel::receive_rsbb_beacon, this);
       set_robot_beacon_callback (&CorePublicChannel::receive_robot_beacon, this);
       set_tablet_beacon_callback (&CorePublicChannel::receive_tablet_beacon, this);
 
       ROS_INFO ("Listening only... beacon transmission will start in 5 seconds.");
+      beacon_thread_ = std::thread (&CorePublicChannel::transmit_beacon, this);
     }
 
     ~CorePublicChannel()
     {
-      beacon_timer_.stop();
+      {
+        std::lock_guard<std::mutex> lock (ss_.mutex);
+        stop_ = true;
+        ss_.beacon_cv.notify_all();
+      }
+      beacon_thread_.join();
       signal_rsbb_beacon_received().disconnect_all_slots();
       signal_robot_beacon_received().disconnect_all_slots();
       signal_tablet_beacon_received().disconnect_all_slots();
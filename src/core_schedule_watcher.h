@@ -0,0 +1,196 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_SCHEDULE_WATCHER_H__
+#define __CORE_SCHEDULE_WATCHER_H__
+
+#include "core_includes.h"
+
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <thread>
+#include <unistd.h>
+
+#include "core_shared_state.h"
+#include "core_zone_manager.h"
+
+
+
+/*
+ * Reloads the benchmarks, passwords and schedule files when they change on
+ * disk, or when /core/reload_schedule is called. The files are parsed and
+ * validated in the watcher thread and only then swapped in, so a broken
+ * file never replaces a working one. Zones that are executing get their new
+ * schedule when the benchmark ends.
+ */
+class CoreScheduleWatcher
+  : boost::noncopyable
+{
+    CoreSharedState& ss_;
+    CoreZoneManager& zone_manager_;
+
+    std::mutex reload_mutex_;
+
+    int inotify_fd_;
+    int stop_fd_;
+    map<int, set<string>> watched_;
+    std::thread thread_;
+
+    ServiceServer reload_srv_;
+
+    bool
+    reload_callback (std_srvs::Empty::Request& req,
+                     std_srvs::Empty::Response& res)
+    {
+      return reload();
+    }
+
+    void
+    watch (string const& file_name)
+    {
+      size_t slash = file_name.find_last_of ('/');
+      string dir = (slash == string::npos) ? "." : file_name.substr (0, slash + 1);
+      string base = (slash == string::npos) ? file_name : file_name.substr (slash + 1);
+
+      // Editors often replace the file instead of writing it, so the
+      // directory is watched
+      int wd = inotify_add_watch (inotify_fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+      if (wd < 0) {
+        ROS_ERROR_STREAM ("Cannot watch " << dir << " for changes: " << strerror (errno));
+        return;
+      }
+      watched_[wd].insert (base);
+    }
+
+    void
+    run()
+    {
+      alignas (inotify_event) char buffer[4096];
+      bool pending = false;
+
+      while (true) {
+        pollfd fds[2] = { { inotify_fd_, POLLIN, 0 }, { stop_fd_, POLLIN, 0 } };
+        // Files are often written in several steps, wait for them to settle
+        int n = poll (fds, 2, pending ? 500 : -1);
+        if (n < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          ROS_ERROR_STREAM ("Schedule watcher stopped: " << strerror (errno));
+          return;
+        }
+        if (fds[1].revents) {
+          return;
+        }
+        if (n == 0) {
+          pending = false;
+          reload();
+          continue;
+        }
+
+        ssize_t length = read (inotify_fd_, buffer, sizeof (buffer));
+        for (char* p = buffer; p < buffer + length;) {
+          inotify_event const* event = reinterpret_cast<inotify_event const*> (p);
+          if (event->len) {
+            auto files = watched_.find (event->wd);
+            if ( (files != watched_.end()) && files->second.count (event->name)) {
+              pending = true;
+            }
+          }
+          p += sizeof (inotify_event) + event->len;
+        }
+      }
+    }
+
+  public:
+    CoreScheduleWatcher (CoreSharedState& ss,
+                         CoreZoneManager& zone_manager)
+      : ss_ (ss)
+      , zone_manager_ (zone_manager)
+      , inotify_fd_ (-1)
+      , stop_fd_ (-1)
+      , reload_srv_ (ss_.nh.advertiseService ("/core/reload_schedule", &CoreScheduleWatcher::reload_callback, this))
+    {
+      if (! param_direct<bool> ("~reload_on_change", true)) {
+        return;
+      }
+
+      inotify_fd_ = inotify_init1 (IN_CLOEXEC);
+      stop_fd_ = eventfd (0, EFD_CLOEXEC);
+      if ( (inotify_fd_ < 0) || (stop_fd_ < 0)) {
+        ROS_ERROR_STREAM ("Cannot watch the schedule for changes: " << strerror (errno));
+        return;
+      }
+
+      CoreConfig const& config = ss_.config.get();
+      watch (config.benchmarks_file);
+      watch (config.passwords_file);
+      watch (config.schedule_file);
+
+      thread_ = std::thread (&CoreScheduleWatcher::run, this);
+    }
+
+    ~CoreScheduleWatcher()
+    {
+      if (thread_.joinable()) {
+        uint64_t one = 1;
+        if (write (stop_fd_, &one, sizeof (one)) != sizeof (one)) {
+          ROS_ERROR ("Could not stop the schedule watcher");
+        }
+        thread_.join();
+      }
+      if (inotify_fd_ >= 0) {
+        close (inotify_fd_);
+      }
+      if (stop_fd_ >= 0) {
+        close (stop_fd_);
+      }
+    }
+
+    bool
+    reload()
+    {
+      std::lock_guard<std::mutex> lock (reload_mutex_);
+
+      CoreConfig const& config = ss_.config.get();
+      unique_ptr<const Benchmarks> benchmarks;
+      unique_ptr<const Passwords> passwords;
+      CoreZoneManager::Schedule schedule;
+      try {
+        benchmarks.reset (new Benchmarks (config.benchmarks_file));
+        passwords.reset (new Passwords (config.passwords_file));
+        schedule = CoreZoneManager::parse_schedule (config.schedule_file, *benchmarks, *passwords);
+      }
+      catch (std::exception const& e) {
+        ROS_ERROR_STREAM ("Schedule not reloaded, keeping the current one: " << e.what());
+        return false;
+      }
+
+      ss_.benchmarks.set (move (benchmarks));
+      ss_.passwords.set (move (passwords));
+      zone_manager_.apply (schedule);
+
+      ROS_INFO ("Schedule reloaded");
+      return true;
+    }
+};
+
+#endif
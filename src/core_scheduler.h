@@ -0,0 +1,353 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_SCHEDULER_H__
+#define __CORE_SCHEDULER_H__
+
+#include "core_includes.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <boost/enable_shared_from_this.hpp>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "core_aux.h"
+#include "core_metrics.h"
+
+
+
+class CoreScheduler;
+
+/*
+ * A timer of the CoreScheduler. Expiries are delivered by adding the slot
+ * itself to the callback queue of the owner, at most once at a time, so
+ * that neither rescheduling nor firing allocates. A slot that is stopped or
+ * restarted after being queued does nothing when called.
+ */
+class CoreSchedulerSlot
+  : public CallbackInterface
+  , public boost::enable_shared_from_this<CoreSchedulerSlot>
+{
+    friend class CoreScheduler;
+    typedef std::chrono::steady_clock clock;
+
+    CallbackQueueInterface* const queue_;
+    const boost::function<void()> callback_;
+    Histogram* const lateness_;
+
+    // Guarded by the mutex of the scheduler
+    size_t heap_index_;
+    clock::time_point deadline_;
+    clock::duration period_;
+
+    // Bumped by each start and stop, invalidates expiries already queued
+    std::atomic<uint64_t> generation_;
+    std::atomic<uint64_t> fired_generation_;
+    std::atomic<clock::rep> fired_deadline_;
+    std::atomic<bool> queued_;
+
+  public:
+    static const size_t NOT_ARMED = numeric_limits<size_t>::max();
+
+    CoreSchedulerSlot (CallbackQueueInterface* queue,
+                       boost::function<void()> const& callback,
+                       Histogram* lateness)
+      : queue_ (queue)
+      , callback_ (callback)
+      , lateness_ (lateness)
+      , heap_index_ (NOT_ARMED)
+      , period_ (clock::duration::zero())
+      , generation_ (0)
+      , fired_generation_ (numeric_limits<uint64_t>::max())
+      , fired_deadline_ (0)
+      , queued_ (false)
+    {
+    }
+
+    virtual CallResult
+    call()
+    {
+      queued_.store (false);
+      if (fired_generation_.load() != generation_.load()) {
+        return Success;
+      }
+      if (lateness_) {
+        lateness_->record (clock::now() - clock::time_point (clock::duration (fired_deadline_.load())));
+      }
+      callback_();
+      return Success;
+    }
+};
+
+
+
+/*
+ * Deadline scheduler shared by all zones, so that benchmark timeouts do
+ * not depend on the ROS timer thread. Armed slots are kept in an indexed
+ * binary min-heap and a single thread sleeps on a timerfd armed for the
+ * earliest deadline. Callbacks run in the queue of the slot owner, usually
+ * the zone thread.
+ */
+class CoreScheduler
+  : boost::noncopyable
+{
+    typedef std::chrono::steady_clock clock;
+
+    Histogram& jitter_;
+
+    std::mutex mutex_;
+    vector<CoreSchedulerSlot*> heap_;
+    int timer_fd_;
+    bool stop_;
+
+    std::thread thread_;
+
+    bool
+    before (size_t a,
+            size_t b) const
+    {
+      return heap_[a]->deadline_ < heap_[b]->deadline_;
+    }
+
+    void
+    swap_nodes (size_t a,
+                size_t b)
+    {
+      std::swap (heap_[a], heap_[b]);
+      heap_[a]->heap_index_ = a;
+      heap_[b]->heap_index_ = b;
+    }
+
+    void
+    sift_up (size_t i)
+    {
+      while ( (i > 0) && before (i, (i - 1) / 2)) {
+        swap_nodes (i, (i - 1) / 2);
+        i = (i - 1) / 2;
+      }
+    }
+
+    void
+    sift_down (size_t i)
+    {
+      while (true) {
+        size_t smallest = i;
+        size_t l = 2 * i + 1;
+        size_t r = l + 1;
+        if ( (l < heap_.size()) && before (l, smallest)) {
+          smallest = l;
+        }
+        if ( (r < heap_.size()) && before (r, smallest)) {
+          smallest = r;
+        }
+        if (smallest == i) {
+          return;
+        }
+        swap_nodes (i, smallest);
+        i = smallest;
+      }
+    }
+
+    void
+    remove (CoreSchedulerSlot* slot)
+    {
+      size_t i = slot->heap_index_;
+      if (i == CoreSchedulerSlot::NOT_ARMED) {
+        return;
+      }
+      slot->heap_index_ = CoreSchedulerSlot::NOT_ARMED;
+      if (i != (heap_.size() - 1)) {
+        heap_[i] = heap_.back();
+        heap_[i]->heap_index_ = i;
+        heap_.pop_back();
+        sift_down (i);
+        sift_up (i);
+      }
+      else {
+        heap_.pop_back();
+      }
+    }
+
+    // With mutex_ locked
+    void
+    arm()
+    {
+      itimerspec spec = {};
+      if (stop_) {
+        spec.it_value.tv_nsec = 1;
+      }
+      else if (! heap_.empty()) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds> (heap_.front()->deadline_.time_since_epoch()).count();
+        // Zero would disarm the timer
+        ns = max<int64_t> (ns, 1);
+        spec.it_value.tv_sec = ns / 1000000000;
+        spec.it_value.tv_nsec = ns % 1000000000;
+      }
+      if (timerfd_settime (timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+        ROS_ERROR_STREAM ("Failed to arm the scheduler timer: " << strerror (errno));
+      }
+    }
+
+    void
+    fire (CoreSchedulerSlot* slot)
+    {
+      slot->fired_deadline_.store (slot->deadline_.time_since_epoch().count());
+      slot->fired_generation_.store (slot->generation_.load());
+      if (! slot->queued_.exchange (true)) {
+        slot->queue_->addCallback (slot->shared_from_this());
+      }
+    }
+
+    void
+    run()
+    {
+      while (true) {
+        {
+          std::lock_guard<std::mutex> lock (mutex_);
+          if (stop_) {
+            return;
+          }
+
+          clock::time_point now = clock::now();
+          while ( (! heap_.empty()) && (heap_.front()->deadline_ <= now)) {
+            CoreSchedulerSlot* slot = heap_.front();
+            jitter_.record (now - slot->deadline_);
+            fire (slot);
+
+            if (slot->period_ > clock::duration::zero()) {
+              // Missed periods are skipped, not fired in a burst
+              do {
+                slot->deadline_ += slot->period_;
+              }
+              while (slot->deadline_ <= now);
+              sift_down (0);
+            }
+            else {
+              remove (slot);
+            }
+          }
+          arm();
+        }
+
+        uint64_t expirations;
+        if ( (read (timer_fd_, &expirations, sizeof (expirations)) < 0)
+             && (errno != EINTR) && (errno != EAGAIN)) {
+          ROS_ERROR_STREAM ("Failed to wait on the scheduler timer: " << strerror (errno));
+        }
+      }
+    }
+
+  public:
+    CoreScheduler (Histogram& jitter)
+      : jitter_ (jitter)
+      , timer_fd_ (timerfd_create (CLOCK_MONOTONIC, TFD_CLOEXEC))
+      , stop_ (false)
+    {
+      if (timer_fd_ < 0) {
+        ROS_FATAL_STREAM ("Failed to create the scheduler timer: " << strerror (errno));
+        abort_rsbb();
+      }
+      heap_.reserve (64);
+      thread_ = std::thread (&CoreScheduler::run, this);
+    }
+
+    ~CoreScheduler()
+    {
+      {
+        std::lock_guard<std::mutex> lock (mutex_);
+        stop_ = true;
+        arm();
+      }
+      thread_.join();
+      close (timer_fd_);
+    }
+
+    // Arms the slot, or moves its deadline if already armed
+    void
+    start (CoreSchedulerSlot* slot,
+           Duration const& delay,
+           Duration const& period)
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      ++slot->generation_;
+      slot->deadline_ = clock::now() + std::chrono::nanoseconds (max<int64_t> (0, delay.toNSec()));
+      slot->period_ = std::chrono::nanoseconds (max<int64_t> (0, period.toNSec()));
+      if (slot->heap_index_ == CoreSchedulerSlot::NOT_ARMED) {
+        slot->heap_index_ = heap_.size();
+        heap_.push_back (slot);
+      }
+      sift_down (slot->heap_index_);
+      sift_up (slot->heap_index_);
+      if (heap_.front() == slot) {
+        arm();
+      }
+    }
+
+    void
+    stop (CoreSchedulerSlot* slot)
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      ++slot->generation_;
+      remove (slot);
+    }
+};
+
+
+
+class ScheduledTimer
+  : boost::noncopyable
+{
+    CoreScheduler& scheduler_;
+    boost::shared_ptr<CoreSchedulerSlot> slot_;
+
+  public:
+    ScheduledTimer (CoreScheduler& scheduler,
+                    CallbackQueueInterface* queue,
+                    boost::function<void()> const& callback,
+                    Histogram* lateness = nullptr)
+      : scheduler_ (scheduler)
+      , slot_ (boost::make_shared<CoreSchedulerSlot> (queue, callback, lateness))
+    {
+    }
+
+    ~ScheduledTimer()
+    {
+      stop();
+    }
+
+    // Restarts the timer, periodic if period is not zero
+    void
+    start (Duration const& delay,
+           Duration const& period = Duration())
+    {
+      scheduler_.start (slot_.get(), delay, period);
+    }
+
+    void
+    stop()
+    {
+      scheduler_.stop (slot_.get());
+    }
+};
+
+#endif
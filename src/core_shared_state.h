@@ -23,51 +23,135 @@
 #include "core_includes.h"
 
 #include "core_aux.h"
+#include "core_config.h"
+#include "core_devices.h"
+#include "core_metrics.h"
+#include "core_port_pool.h"
+#include "core_scheduler.h"
+#include "core_transmitter.h"
 
 
 
+/*
+ * Robots that sent a beacon in the last ~robot_timeout seconds.
+ *
+ * Robots are indexed by team and robot name in hash maps. Expiry uses a
+ * timing wheel with one slot per second: each robot is listed in the slot
+ * of its last beacon, and when a slot expires only the robots that did not
+ * beacon again since are removed. Teams are removed with their last robot.
+ */
 class ActiveRobots
   : boost::noncopyable
 {
+    struct Entry {
+      roah_rsbb::RobotInfo::ConstPtr info;
+      uint32_t slot;
+    };
+    typedef unordered_map<string, Entry> Robots;
+
+    std::mutex mutex_;
+
     Duration robot_timeout_;
+    uint32_t timeout_slots_;
 
-    // sum . map size team_robot_map_ == size last_beacon_map_
-    map<string, map<string, roah_rsbb::RobotInfo::ConstPtr>> team_robot_map_;
-    map<Time, roah_rsbb::RobotInfo::ConstPtr> last_beacon_map_;
+    unordered_map<string, Robots> teams_;
+    size_t size_;
+
+    vector<vector<pair<string, string>>> wheel_;
+    // First slot not yet expired
+    uint32_t next_slot_;
+
+    static bool
+    less (roah_rsbb::RobotInfo::ConstPtr const& a,
+          roah_rsbb::RobotInfo::ConstPtr const& b)
+    {
+      return (a->team < b->team) || ( (a->team == b->team) && (a->robot < b->robot));
+    }
 
     void
     update ()
     {
       auto now = Time::now();
 
-      while ( (! last_beacon_map_.empty())
-              && ( (last_beacon_map_.begin()->first + robot_timeout_) < now)) {
-        team_robot_map_[last_beacon_map_.begin()->second->team].erase (last_beacon_map_.begin()->second->robot);
-        last_beacon_map_.erase (last_beacon_map_.begin());
+      // Slots up to last are older than robot_timeout_ for sure
+      if (now.sec <= timeout_slots_) {
+        return;
+      }
+      uint32_t last = now.sec - timeout_slots_ - 1;
+      if (next_slot_ == 0) {
+        next_slot_ = last + 1;
+        return;
+      }
+      if ( (last >= next_slot_) && ( (last - next_slot_) >= wheel_.size())) {
+        // Went around the whole wheel, every slot expires once
+        next_slot_ = last + 1 - wheel_.size();
+      }
+
+      for (; next_slot_ <= last; ++next_slot_) {
+        vector<pair<string, string>>& bucket = wheel_[next_slot_ % wheel_.size()];
+        for (auto const& key : bucket) {
+          auto team = teams_.find (key.first);
+          if (team == teams_.end()) {
+            continue;
+          }
+          auto robot = team->second.find (key.second);
+          if ( (robot == team->second.end())
+               || (robot->second.slot > next_slot_)) {
+            // Refreshed since, listed in a later slot
+            continue;
+          }
+          team->second.erase (robot);
+          --size_;
+          if (team->second.empty()) {
+            teams_.erase (team);
+          }
+        }
+        bucket.clear();
       }
     }
 
+    roah_rsbb::RobotInfo::ConstPtr
+    first (Robots const& robots)
+    {
+      roah_rsbb::RobotInfo::ConstPtr ret;
+      for (auto const& i : robots) {
+        if ( (! ret) || less (i.second.info, ret)) {
+          ret = i.second.info;
+        }
+      }
+      return ret;
+    }
+
   public:
     ActiveRobots()
       : robot_timeout_ (param_direct<double> ("~robot_timeout", 30.0))
+      , timeout_slots_ (static_cast<uint32_t> (ceil (robot_timeout_.toSec())))
+      , size_ (0)
+      , wheel_ (timeout_slots_ + 2)
+      , next_slot_ (0)
     {
     }
 
     void
     add (roah_rsbb::RobotInfo::ConstPtr const& ri)
     {
-      auto last_team = team_robot_map_.find (ri->team);
-      if (last_team != team_robot_map_.end()) {
-        auto last = last_team->second.find (ri->robot);
-        if (last != last_team->second.end()) {
-          last_beacon_map_.erase (last->second->beacon);
-          last_beacon_map_[ri->beacon] = ri;
-          last->second = ri;
-          return;
-        }
+      std::lock_guard<std::mutex> lock (mutex_);
+      update();
+
+      uint32_t slot = max (ri->beacon.sec, next_slot_);
+
+      Robots& robots = teams_[ri->team];
+      auto robot = robots.find (ri->robot);
+      if (robot == robots.end()) {
+        robot = robots.insert (make_pair (ri->robot, Entry())).first;
+        robot->second.slot = 0;
+        ++size_;
+      }
+      robot->second.info = ri;
+      if (robot->second.slot != slot) {
+        robot->second.slot = slot;
+        wheel_[slot % wheel_.size()].push_back (make_pair (ri->team, ri->robot));
       }
-      team_robot_map_[ri->team][ri->robot] = ri;
-      last_beacon_map_[ri->beacon] = ri;
     }
 
     void
@@ -84,49 +168,67 @@ class ActiveRobots
       add (msg);
     }
 
+    /*
+     * All active robots, sorted by team and robot.
+     */
     void
     msg (vector<roah_rsbb::RobotInfo>& msg)
     {
-      update();
-
-      for (auto const& iteam : team_robot_map_) {
-        for (auto const& i : iteam.second) {
-          msg.push_back (* (i.second));
+      vector<roah_rsbb::RobotInfo::ConstPtr> all;
+      {
+        std::lock_guard<std::mutex> lock (mutex_);
+        update();
+
+        all.reserve (size_);
+        for (auto const& team : teams_) {
+          for (auto const& robot : team.second) {
+            all.push_back (robot.second.info);
+          }
         }
       }
+
+      sort (all.begin(), all.end(), &ActiveRobots::less);
+      msg.reserve (msg.size() + all.size());
+      for (auto const& i : all) {
+        msg.push_back (*i);
+      }
     }
 
-    vector<roah_rsbb::RobotInfo>
+    /*
+     * The first robot of each team, sorted by team.
+     */
+    vector<roah_rsbb::RobotInfo::ConstPtr>
     get ()
     {
-      update();
-
-      vector<roah_rsbb::RobotInfo> ret;
-      ret.reserve (team_robot_map_.size());
-
-      for (auto const& iteam : team_robot_map_) {
-        map<string, roah_rsbb::RobotInfo::ConstPtr> rm = iteam.second;
-
-        if (! rm.empty()) {
-          ret.push_back (* (rm.begin()->second));
+      vector<roah_rsbb::RobotInfo::ConstPtr> ret;
+      {
+        std::lock_guard<std::mutex> lock (mutex_);
+        update();
+
+        ret.reserve (teams_.size());
+        for (auto const& team : teams_) {
+          ret.push_back (first (team.second));
         }
       }
 
+      sort (ret.begin(), ret.end(), &ActiveRobots::less);
       return ret;
     }
 
-    roah_rsbb::RobotInfo
+    /*
+     * The first robot of the team, or null if there is none.
+     */
+    roah_rsbb::RobotInfo::ConstPtr
     get (string const& team)
     {
+      std::lock_guard<std::mutex> lock (mutex_);
       update();
 
-      map<string, roah_rsbb::RobotInfo::ConstPtr> rm = team_robot_map_[team];
-
-      if (rm.empty()) {
-        return roah_rsbb::RobotInfo();
+      auto robots = teams_.find (team);
+      if (robots == teams_.end()) {
+        return roah_rsbb::RobotInfo::ConstPtr();
       }
-
-      return * (rm.begin()->second);
+      return first (robots->second);
     }
 };
 
@@ -135,22 +237,20 @@ class ActiveRobots
 struct ScoringItem {
   typedef enum { SCORING_BOOL, SCORING_UINT } scoring_type_t;
 
-  string group;
+  uint16_t group;
   string desc;
   scoring_type_t type;
-  int32_t current_value;
 
   ScoringItem (string const& benchmark,
                string const& group_name,
+               uint16_t group_index,
                YAML::Node const& item_node)
-    : group (group_name)
-    , current_value (0)
+    : group (group_index)
   {
     using namespace YAML;
 
     if (! item_node["type"]) {
-      ROS_FATAL_STREAM ("Benchmark \"" << benchmark << "\" scoring item in \"" << group_name << "\" is missing a \"type\" entry! :\n" << item_node);
-      abort_rsbb();
+      THROW_CONFIG_ERROR ("Benchmark \"" << benchmark << "\" scoring item in \"" << group_name << "\" is missing a \"type\" entry! :\n" << item_node);
     }
     string type_s = item_node["type"].as<string>();
     if (type_s == "bool") {
@@ -160,13 +260,11 @@ struct ScoringItem {
       type = SCORING_UINT;
     }
     else {
-      ROS_FATAL_STREAM ("Benchmark \"" << benchmark << "\" scoring item in \"" << group_name << "\" type is unknown:" << type_s);
-      abort_rsbb();
+      THROW_CONFIG_ERROR ("Benchmark \"" << benchmark << "\" scoring item in \"" << group_name << "\" type is unknown:" << type_s);
     }
 
     if (! item_node["desc"]) {
-      ROS_FATAL_STREAM ("Benchmark \"" << benchmark << "\" scoring item in \"" << group_name << "\" is missing a \"desc\" entry! :\n" << item_node);
-      abort_rsbb();
+      THROW_CONFIG_ERROR ("Benchmark \"" << benchmark << "\" scoring item in \"" << group_name << "\" is missing a \"desc\" entry! :\n" << item_node);
     }
     desc = item_node["desc"].as<string>();
   }
@@ -174,6 +272,116 @@ struct ScoringItem {
 
 
 
+struct ScoringGroup {
+  string name;
+  uint16_t first_id;
+  uint16_t size;
+};
+
+
+
+/*
+ * Scoring section of a benchmark, compiled once when benchmarks.yaml is
+ * loaded. Items are identified by their position, so scores are looked up
+ * by index instead of by group and description. The hash covers the whole
+ * schema and lets clients detect that they refer to an outdated one.
+ */
+class ScoringSchema
+{
+    vector<ScoringItem> items_;
+    vector<ScoringGroup> groups_;
+    uint32_t hash_;
+
+    static void
+    hash_add (uint32_t& h,
+              string const& s)
+    {
+      // FNV-1a, which is stable across processes unlike std::hash
+      for (unsigned char c : s) {
+        h = (h ^ c) * 16777619u;
+      }
+      h = (h ^ 0xffu) * 16777619u;
+    }
+
+  public:
+    ScoringSchema()
+      : hash_ (2166136261u)
+    {
+    }
+
+    void
+    add (string const& benchmark,
+         string const& group_name,
+         YAML::Node const& item_node)
+    {
+      if (items_.size() >= numeric_limits<uint16_t>::max()) {
+        THROW_CONFIG_ERROR ("Benchmark \"" << benchmark << "\" has too many scoring items!");
+      }
+      // Consecutive entries with the same name form a single group
+      if (groups_.empty() || (groups_.back().name != group_name)) {
+        groups_.push_back (ScoringGroup{group_name, static_cast<uint16_t> (items_.size()), 0});
+        hash_add (hash_, group_name);
+      }
+      items_.push_back (ScoringItem (benchmark, group_name, groups_.size() - 1, item_node));
+      ++ (groups_.back().size);
+      hash_add (hash_, items_.back().desc);
+      hash_add (hash_, (items_.back().type == ScoringItem::SCORING_BOOL) ? "b" : "u");
+    }
+
+    size_t
+    size() const
+    {
+      return items_.size();
+    }
+
+    uint32_t
+    hash() const
+    {
+      return hash_;
+    }
+
+    ScoringItem const*
+    item (uint16_t id) const
+    {
+      return (id < items_.size()) ? &items_[id] : nullptr;
+    }
+
+    string const&
+    group_name (ScoringItem const& item) const
+    {
+      return groups_[item.group].name;
+    }
+
+    void
+    msg (vector<int32_t> const& values,
+         vector<roah_rsbb::ZoneScoreGroup>& msg) const
+    {
+      msg.reserve (groups_.size());
+      for (ScoringGroup const& g : groups_) {
+        msg.push_back (roah_rsbb::ZoneScoreGroup());
+        roah_rsbb::ZoneScoreGroup& group = msg.back();
+        group.group_name = g.name;
+        group.first_id = g.first_id;
+        group.types.reserve (g.size);
+        group.descriptions.reserve (g.size);
+        for (size_t id = g.first_id; id < g.first_id + g.size; ++id) {
+          switch (items_[id].type) {
+            case ScoringItem::SCORING_BOOL:
+              group.types.push_back (roah_rsbb::ZoneScoreGroup::SCORING_BOOL);
+              break;
+            case ScoringItem::SCORING_UINT:
+              group.types.push_back (roah_rsbb::ZoneScoreGroup::SCORING_UINT);
+              break;
+          }
+          group.descriptions.push_back (items_[id].desc);
+        }
+        group.current_values.assign (values.begin() + g.first_id, values.begin() + g.first_id + g.size);
+      }
+    }
+};
+
+
+
 struct Benchmark {
   string name;
   string prefix;
@@ -181,47 +389,60 @@ struct Benchmark {
   string code;
   Duration timeout;
   Duration total_timeout;
-  vector<ScoringItem> scoring;
+  ScoringSchema scoring;
 };
 
 
 
+inline bool
+same_benchmark (Benchmark const& a,
+                Benchmark const& b)
+{
+  return (&a == &b)
+         || ( (a.name == b.name)
+              && (a.desc == b.desc)
+              && (a.prefix == b.prefix)
+              && (a.timeout == b.timeout)
+              && (a.total_timeout == b.total_timeout)
+              && (a.scoring.hash() == b.scoring.hash()));
+}
+
+
+
 class Benchmarks
 {
-    map<string, Benchmark> by_code_;
+    map<string, shared_ptr<const Benchmark>> by_code_;
 
   public:
-    Benchmarks()
+    /*
+     * Throws config_error, or YAML::Exception if the file cannot be parsed.
+     */
+    Benchmarks (string const& file_name)
     {
       using namespace YAML;
 
-      Node file = LoadFile (param_direct<string> ("~benchmarks_file", "benchmarks.yaml"));
+      Node file = LoadFile (file_name);
       if (! file.IsSequence()) {
-        ROS_FATAL_STREAM ("Benchmarks file is not a sequence!");
-        abort_rsbb();
+        THROW_CONFIG_ERROR ("Benchmarks file is not a sequence!");
       }
       for (Node const& benchmark_node : file) {
         if (! benchmark_node.IsMap()) {
-          ROS_FATAL_STREAM ("Benchmarks file has a benchmark entry that is not a map!");
-          abort_rsbb();
+          THROW_CONFIG_ERROR ("Benchmarks file has a benchmark entry that is not a map!");
         }
         if (! benchmark_node["name"]) {
-          ROS_FATAL_STREAM ("Benchmarks file is missing a \"node\" entry!");
-          abort_rsbb();
+          THROW_CONFIG_ERROR ("Benchmarks file is missing a \"node\" entry!");
         }
         if (! benchmark_node["desc"]) {
-          ROS_FATAL_STREAM ("Benchmarks file is missing a \"desc\" entry!");
-          abort_rsbb();
+          THROW_CONFIG_ERROR ("Benchmarks file is missing a \"desc\" entry!");
         }
         if (! benchmark_node["code"]) {
-          ROS_FATAL_STREAM ("Benchmarks file is missing a \"code\" entry!");
-          abort_rsbb();
+          THROW_CONFIG_ERROR ("Benchmarks file is missing a \"code\" entry!");
         }
         if (! benchmark_node["timeout"]) {
-          ROS_FATAL_STREAM ("Benchmarks file is missing a \"timeout\" entry!");
-          abort_rsbb();
+          THROW_CONFIG_ERROR ("Benchmarks file is missing a \"timeout\" entry!");
         }
-        Benchmark b;
+        shared_ptr<Benchmark> benchmark = make_shared<Benchmark>();
+        Benchmark& b = *benchmark;
         b.name = benchmark_node["name"].as<string>();
         b.desc = benchmark_node["desc"].as<string>();
         b.code = benchmark_node["code"].as<string>();
@@ -238,40 +459,50 @@ class Benchmarks
 
         if (benchmark_node["scoring"]) {
           if (! benchmark_node["scoring"].IsSequence()) {
-            ROS_FATAL_STREAM ("Benchmark \"" << b.name << "\" \"scoring\" entry is not a sequence! :\n" << benchmark_node["scoring"]);
-            abort_rsbb();
+            THROW_CONFIG_ERROR ("Benchmark \"" << b.name << "\" \"scoring\" entry is not a sequence! :\n" << benchmark_node["scoring"]);
           }
           for (Node const& scoring_node : benchmark_node["scoring"]) {
             if (! scoring_node.IsMap()) {
-              ROS_FATAL_STREAM ("Benchmark \"" << b.name << "\" \"scoring\" entry is not a sequence of maps! :\n" << scoring_node);
-              abort_rsbb();
+              THROW_CONFIG_ERROR ("Benchmark \"" << b.name << "\" \"scoring\" entry is not a sequence of maps! :\n" << scoring_node);
             }
             for (YAML::const_iterator it = scoring_node.begin(); it != scoring_node.end(); ++it) {
               string group_name = it->first.as<string>();
               if (! it->second.IsSequence()) {
-                ROS_FATAL_STREAM ("Benchmark \"" << b.name << "\" scoring \"" << it->first << "\" is not a sequence! :\n" << it->second);
-                abort_rsbb();
+                THROW_CONFIG_ERROR ("Benchmark \"" << b.name << "\" scoring \"" << it->first << "\" is not a sequence! :\n" << it->second);
               }
               for (Node const& item_node : it->second) {
-                b.scoring.push_back (ScoringItem (b.name, group_name, item_node));
+                b.scoring.add (b.name, group_name, item_node);
               }
             }
           }
         }
-        by_code_[b.code] = b;
+        by_code_[b.code] = benchmark;
       }
     }
 
-    Benchmark const&
+    shared_ptr<const Benchmark> const&
     get (string const& code) const
     {
       auto b = by_code_.find (code);
       if (b == by_code_.end()) {
-        ROS_FATAL_STREAM ("Could not find benchmark with code \"" << code << "\"");
-        abort_rsbb();
+        THROW_CONFIG_ERROR ("Could not find benchmark with code \"" << code << "\"");
       }
       return b->second;
     }
+
+    bool
+    operator== (Benchmarks const& other) const
+    {
+      if (by_code_.size() != other.by_code_.size()) {
+        return false;
+      }
+      for (auto i = by_code_.cbegin(), j = other.by_code_.cbegin(); i != by_code_.cend(); ++i, ++j) {
+        if ( (i->first != j->first) || ! same_benchmark (*i->second, *j->second)) {
+          return false;
+        }
+      }
+      return true;
+    }
 };
 
 
@@ -281,65 +512,170 @@ class Passwords
     map<string, string> passwords_;
 
   public:
-    Passwords()
+    /*
+     * Throws config_error, or YAML::Exception if the file cannot be parsed.
+     */
+    Passwords (string const& file_name)
     {
       using namespace YAML;
 
-      Node file = LoadFile (param_direct<string> ("~passwords_file", "passwords.yaml"));
+      Node file = LoadFile (file_name);
       if (! file.IsMap()) {
-        ROS_FATAL_STREAM ("Passwords file is not a map!");
-        abort_rsbb();
+        THROW_CONFIG_ERROR ("Passwords file is not a map!");
       }
       for (auto const& team_node : file) {
         passwords_[team_node.first.as<string>()] = team_node.second.as<string>();
       }
     }
 
+    bool
+    has (string const& team) const
+    {
+      return passwords_.count (team);
+    }
+
     string const&
     get (string const& team) const
     {
       auto b = passwords_.find (team);
       if (b == passwords_.end()) {
-        ROS_FATAL_STREAM ("Could not find password for team \"" << team << "\"");
-        abort_rsbb();
+        THROW_CONFIG_ERROR ("Could not find password for team \"" << team << "\"");
       }
       return b->second;
     }
+
+    bool
+    operator== (Passwords const& other) const
+    {
+      return passwords_ == other.passwords_;
+    }
 };
 
 
 
+/*
+ * Immutable data that is replaced when its file is reloaded. Like
+ * CoreConfigSnapshot, old versions are kept alive, as readers may still
+ * hold references to them. Data equal to the current one is not stored,
+ * so only actual changes add a version.
+ */
+template<typename T>
+class ReloadableSnapshot
+  : boost::noncopyable
+{
+    std::mutex mutex_;
+    list<unique_ptr<const T>> snapshots_;
+    std::atomic<const T*> current_;
+
+  public:
+    ReloadableSnapshot (unique_ptr<const T> initial)
+      : current_ (nullptr)
+    {
+      set (move (initial));
+    }
+
+    /*
+     * Returns false if t is equal to the current data, which is kept.
+     */
+    bool
+    set (unique_ptr<const T> t)
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      if (! snapshots_.empty() && (*t == *snapshots_.back())) {
+        return false;
+      }
+      snapshots_.push_back (move (t));
+      current_.store (snapshots_.back().get(), std::memory_order_release);
+      return true;
+    }
+
+    T const&
+    get() const
+    {
+      return * (current_.load (std::memory_order_acquire));
+    }
+};
+
+
+
+template<typename T>
+unique_ptr<const T>
+load_or_abort (string const& file_name)
+{
+  unique_ptr<const T> t;
+  try {
+    t.reset (new T (file_name));
+  }
+  catch (std::exception const& e) {
+    ROS_FATAL_STREAM ("Error loading " << file_name << ": " << e.what());
+    abort_rsbb();
+  }
+  return t;
+}
+
+
+
+/*
+ * State shared by all zones and the global callbacks, which run in
+ * different threads. The constant members, config, metrics, scheduler,
+ * transmitter, devices, active_robots, benchmarks, passwords,
+ * schedule_version and private_ports can be used directly; everything else
+ * must only be accessed with mutex locked.
+ */
 struct CoreSharedState
     : boost::noncopyable {
   NodeHandle nh;
+  CoreConfigSnapshot config;
+  CoreMetrics metrics;
+  CoreScheduler scheduler;
+  CoreTransmitter transmitter;
+  CoreDevices devices;
   ActiveRobots active_robots;
-  string status;
-  const Benchmarks benchmarks;
-  const Passwords passwords;
+  ReloadableSnapshot<Benchmarks> benchmarks;
+  ReloadableSnapshot<Passwords> passwords;
+  // Incremented whenever the events of a zone, or the set of zones, change
+  std::atomic<unsigned> schedule_version;
+  CorePortPool private_ports;
   const string run_uuid;
+
+  std::mutex mutex;
+  string status;
   map<string, pair<string, uint32_t>> benchmarking_robots;
   bool tablet_display_map;
   roah_devices::DevicesState::ConstPtr last_devices_state;
   Time last_tablet_time;
   std::shared_ptr<const roah_rsbb_msgs::TabletBeacon> last_tablet;
-
-  unsigned short private_port_;
+  // Incremented when benchmarking_robots, tablet_display_map,
+  // last_devices_state or last_tablet change, use beacon_changed()
+  unsigned beacon_version;
+  std::condition_variable beacon_cv;
 
   CoreSharedState()
-    : status ("Initializing...")
+    : config (nh)
+    , metrics (nh)
+    , scheduler (metrics.scheduler_jitter)
+    , transmitter (scheduler, Duration (0.2))
+    , devices (config)
+    , benchmarks (load_or_abort<Benchmarks> (config.get().benchmarks_file))
+    , passwords (load_or_abort<Passwords> (config.get().passwords_file))
+    , schedule_version (0)
+    , private_ports (param_direct<int> ("~rsbb_port", 6666) + 1, param_direct<int> ("~private_ports", 100))
     , run_uuid (to_string (boost::uuids::random_generator() ()))
+    , status ("Initializing...")
     , tablet_display_map (false)
     , last_devices_state (boost::make_shared<roah_devices::DevicesState>())
     , last_tablet_time (TIME_MIN)
     , last_tablet (/*empty*/)
-    , private_port_ (param_direct<int> ("~rsbb_port", 6666))
+    , beacon_version (0)
   {
   }
 
-  unsigned short
-  private_port()
+  // With mutex locked, sends the RSBB beacon without waiting for the next period
+  void
+  beacon_changed()
   {
-    return ++private_port_;
+    ++beacon_version;
+    beacon_cv.notify_all();
   }
 };
 
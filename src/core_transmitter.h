@@ -0,0 +1,127 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CORE_TRANSMITTER_H__
+#define __CORE_TRANSMITTER_H__
+
+#include "core_includes.h"
+
+#include <chrono>
+
+#include "core_scheduler.h"
+
+
+
+/*
+ * Periodic transmission of the private channel states. All senders share
+ * the same period and phase, so the scheduler wakes up once per period for
+ * all of them. Senders are grouped by callback queue, and each group is
+ * sent from a single callback in that queue, in the order they were added.
+ */
+class CoreTransmitter
+  : boost::noncopyable
+{
+    struct Batch {
+      std::mutex mutex;
+      vector<pair<uint64_t, boost::function<void()>>> senders;
+      unique_ptr<ScheduledTimer> timer;
+    };
+
+    CoreScheduler& scheduler_;
+    const Duration period_;
+
+    std::mutex mutex_;
+    map<CallbackQueueInterface*, unique_ptr<Batch>> batches_;
+
+    static void
+    send (Batch* batch)
+    {
+      std::lock_guard<std::mutex> lock (batch->mutex);
+      for (auto const& i : batch->senders) {
+        i.second();
+      }
+    }
+
+    // Delay to the next multiple of the period, to keep all batches in phase
+    Duration
+    phase_delay() const
+    {
+      int64_t period = period_.toNSec();
+      int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+      Duration delay;
+      delay.fromNSec (period - (now % period));
+      return delay;
+    }
+
+  public:
+    CoreTransmitter (CoreScheduler& scheduler,
+                     Duration const& period)
+      : scheduler_ (scheduler)
+      , period_ (period)
+    {
+    }
+
+    void
+    add (CallbackQueueInterface* queue,
+         uint64_t owner_id,
+         boost::function<void()> const& sender)
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      unique_ptr<Batch>& batch = batches_[queue];
+      if (! batch) {
+        batch.reset (new Batch());
+        batch->timer.reset (new ScheduledTimer (scheduler_, queue, boost::bind (&CoreTransmitter::send, batch.get())));
+        batch->timer->start (phase_delay(), period_);
+      }
+      std::lock_guard<std::mutex> batch_lock (batch->mutex);
+      batch->senders.emplace_back (owner_id, sender);
+    }
+
+    /*
+     * Must be called from the thread of the queue. Afterwards, the sender is
+     * not called again.
+     */
+    void
+    remove (CallbackQueueInterface* queue,
+            uint64_t owner_id)
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      auto it = batches_.find (queue);
+      if (it == batches_.end()) {
+        return;
+      }
+      Batch& batch = *it->second;
+      {
+        std::lock_guard<std::mutex> batch_lock (batch.mutex);
+        for (auto i = batch.senders.begin(); i != batch.senders.end(); ++i) {
+          if (i->first == owner_id) {
+            batch.senders.erase (i);
+            break;
+          }
+        }
+        if (! batch.senders.empty()) {
+          return;
+        }
+      }
+      // A tick already queued is discarded by the scheduler slot
+      batches_.erase (it);
+    }
+};
+
+#endif
@@ -22,11 +22,14 @@
 
 #include "core_includes.h"
 
+#include "core_bag_writer.h"
+#include "core_scheduler.h"
 #include "core_shared_state.h"
 
 struct Event {
 	string benchmark_code;
-	Benchmark benchmark;
+	// Shared by all the events of the same benchmark
+	shared_ptr<const Benchmark> benchmark;
 	string team;
 	string password;
 	unsigned round;
@@ -51,12 +54,29 @@ std::ostream& operator<<(std::ostream& os, const Event& e) {
 	return os;
 }
 
+/*
+ * Bounded log of display messages. Entries are kept in a deque and the
+ * oldest are dropped when more than capacity bytes are stored, so appending
+ * does not depend on how long the benchmark has been running. Entries are
+ * numbered consecutively, and the epoch tells this log apart from the ones
+ * of other benchmarks, so clients can receive only the entries they miss.
+ */
 class DisplayText: boost::noncopyable {
-	ostringstream text_;
+	struct Entry {
+		uint64_t seq;
+		string text;
+	};
+
+	deque<Entry> entries_;
+	size_t size_;
+	size_t capacity_;
+	uint64_t next_seq_;
+	const uint64_t epoch_;
 	string last_;
 
 public:
-	DisplayText() {
+	DisplayText(size_t capacity) :
+			size_(0), capacity_(capacity), next_seq_(0), epoch_(Time::now().toNSec()) {
 	}
 
 	void add(Time const& now, string const& msg) {
@@ -66,55 +86,76 @@ public:
 
 		last_ = msg;
 
-		text_ << endl;
-		text_ << " - " << to_string(now);
-		//text_ << endl;
-		text_ << " - ";
-		text_ << msg;
+		entries_.push_back(Entry());
+		Entry& e = entries_.back();
+		e.seq = next_seq_++;
+		e.text.reserve(msg.size() + 32);
+		e.text += "\n - ";
+		e.text += to_string(now);
+		e.text += " - ";
+		e.text += msg;
+		size_ += e.text.size();
+
+		// Always keep the newest entry, even if it alone exceeds the capacity
+		while ((size_ > capacity_) && (entries_.size() > 1)) {
+			size_ -= entries_.front().text.size();
+			entries_.pop_front();
+		}
 	}
 
 	void add(string const& msg) {
 		add(Time::now(), msg);
 	}
 
-	string str() {
-		return text_.str();
+	/*
+	 * Sequence number of the next entry. Clients can compare it with a
+	 * previous value to know if anything was added.
+	 */
+	uint64_t seq() const {
+		return next_seq_;
 	}
 
-	string last(size_t length = 1) {
-		string ret = text_.str();
-		if (length >= ret.size()) {
-			return ret;
+	uint64_t epoch() const {
+		return epoch_;
+	}
+
+	/*
+	 * Appends the entries from seq on, or from the oldest still stored if
+	 * seq was dropped. Returns the sequence number of the first appended.
+	 */
+	uint64_t since(uint64_t seq, vector<string>& out) const {
+		if (entries_.empty() || (seq >= next_seq_)) {
+			return next_seq_;
+		}
+		uint64_t first = max(seq, entries_.front().seq);
+		for (auto i = entries_.begin() + (first - entries_.front().seq); i != entries_.end(); ++i) {
+			out.push_back(i->text);
 		}
-		return ret.substr(ret.size() - length);
+		return first;
 	}
+
 };
 
 class RsbbLog: boost::noncopyable {
-	rosbag::Bag bag_;
+	unique_ptr<BagWriter> bag_;
 	DisplayText& display_text_;
 
 public:
-	RsbbLog(string const& team, unsigned round, unsigned run, string const& uuid, DisplayText& display_text) :
+	RsbbLog(CoreConfig const& config, CoreMetrics& metrics, string const& team, unsigned round, unsigned run, string const& uuid, DisplayText& display_text) :
 			display_text_(display_text) {
-		string log_dir = param_direct<string>("~log_dir", ".");
-		system(string("mkdir -p " + log_dir).c_str());
+		system(string("mkdir -p " + config.log_dir).c_str());
 
 		ostringstream o;
-		o << log_dir << "/online_log_";
+		o << config.log_dir << "/online_log_";
 		o << to_string(Time::now());
 		o << "_" << team << "_round" << round << "_run" << run;
 		o << "_" << uuid << ".bag";
-		bag_.open(o.str(), rosbag::bagmode::Write);
-	}
-
-	~RsbbLog() {
-		bag_.close();
+		bag_.reset(new BagWriter(o.str(), config.log_queue_size, metrics.log_enqueue, metrics.log_write));
 	}
 
 	void log_empty(string const& topic, Time const& time) {
 		std_msgs::Empty msg;
-		bag_.write(topic, time, msg);
+		bag_->write(topic, time, msg);
 
 		display_text_.add(time, topic);
 	}
@@ -122,7 +163,7 @@ public:
 	void log_uint8(string const& topic, Time const& time, uint8_t i) {
 		std_msgs::UInt8 msg;
 		msg.data = i;
-		bag_.write(topic, time, msg);
+		bag_->write(topic, time, msg);
 
 		display_text_.add(time, topic + "\n" + to_string(i));
 	}
@@ -130,15 +171,24 @@ public:
 	void log_string(string const& topic, Time const& time, string const& s) {
 		std_msgs::String msg;
 		msg.data = s;
-		bag_.write(topic, time, msg);
+		bag_->write(topic, time, msg);
 
 		display_text_.add(time, topic + "\n" + s);
 	}
 
-	void log_score(string const& topic, Time const& time, roah_rsbb::Score const& msg) {
-		bag_.write(topic, time, msg);
+	void log_scoring_schema(string const& topic, Time const& time, roah_rsbb::ScoringSchema const& msg) {
+		bag_->write(topic, time, msg);
+	}
+
+	void log_scores(string const& topic, Time const& time, roah_rsbb::Scores const& msg, ScoringSchema const& schema) {
+		bag_->write(topic, time, msg);
 
-		display_text_.add(time, topic + "\n" + msg.group + ", " + msg.desc + " -> " + to_string(msg.value));
+		string text = topic + "\nversion " + to_string(msg.version);
+		for (roah_rsbb::Score const& score : msg.scores) {
+			ScoringItem const& item = *schema.item(score.id);
+			text += "\n" + schema.group_name(item) + ", " + item.desc + " -> " + to_string(score.value);
+		}
+		display_text_.add(time, text);
 	}
 
 	void set_state(Time const& now, roah_rsbb_msgs::BenchmarkState::State const& state, string const& desc) {
@@ -165,6 +215,11 @@ public:
 
 	void end() {
 		log_empty("/rsbb_log/end", Time::now());
+		bag_->flush();
+	}
+
+	BagWriter const& writer() const {
+		return *bag_;
 	}
 
 #if 0
@@ -172,7 +227,7 @@ public:
 	void write (std::string const& topic, ros::Time const& time, T const& msg,
 			boost::shared_ptr<ros::M_string> connection_header = boost::shared_ptr<ros::M_string>())
 	{
-		bag_.write<T> (topic, time, msg, connection_header);
+		bag_->write<T> (topic, time, msg, connection_header);
 	}
 #endif
 };
@@ -202,7 +257,6 @@ public:
 };
 
 class TimeControl {
-	CoreSharedState& ss_;
 	Duration timeout_;
 
 	Time start_time_;
@@ -211,15 +265,16 @@ class TimeControl {
 	bool paused_;
 	Time pause_start_;
 
-	Timer timeout_timer_;
+	// Fires in the queue of nh, the zone thread
+	ScheduledTimer timeout_timer_;
 	const function<void(void)> timeout_2_;
 
-	void timeout(const TimerEvent& timer_event) {
+	void timeout() {
 		if (paused_) {
 			return;
 		}
 
-		if (start_timer(timer_event.current_real)) {
+		if (start_timer(Time::now())) {
 			return;
 		}
 
@@ -228,20 +283,20 @@ class TimeControl {
 
 	bool start_timer(Time const& now) {
 		Duration until_timeout = get_until_timeout(now);
-		timeout_timer_.stop();
 		if (until_timeout > Duration()) {
-			timeout_timer_ = ss_.nh.createTimer(until_timeout, &TimeControl::timeout, this, true, true);
+			timeout_timer_.start(until_timeout);
 			return true;
 		}
+		timeout_timer_.stop();
 		return false;
 	}
 
 public:
-	TimeControl(CoreSharedState& ss, Duration timeout, function<void(void)> const& timeout_2) :
-			ss_(ss), timeout_(timeout), delay_acc_(), paused_(false), timeout_timer_(), timeout_2_(timeout_2) {
+	TimeControl(NodeHandle& nh, CoreScheduler& scheduler, Histogram& lateness, Duration timeout, function<void(void)> const& timeout_2) :
+			timeout_(timeout), delay_acc_(), paused_(false), timeout_timer_(scheduler, nh.getCallbackQueue(), boost::bind(&TimeControl::timeout, this), &lateness), timeout_2_(timeout_2) {
 	}
-	TimeControl(CoreSharedState& ss, Duration timeout, bool paused, function<void(void)> const& timeout_2) :
-			ss_(ss), timeout_(timeout), delay_acc_(), paused_(paused), timeout_timer_(), timeout_2_(timeout_2) {
+	TimeControl(NodeHandle& nh, CoreScheduler& scheduler, Histogram& lateness, Duration timeout, bool paused, function<void(void)> const& timeout_2) :
+			timeout_(timeout), delay_acc_(), paused_(paused), timeout_timer_(scheduler, nh.getCallbackQueue(), boost::bind(&TimeControl::timeout, this), &lateness), timeout_2_(timeout_2) {
 	}
 
 	~TimeControl() {
@@ -301,6 +356,25 @@ public:
 	Duration get_elapsed(Time const& now) {
 		return (paused_ ? pause_start_ : now) - start_time_ - delay_acc_;
 	}
+
+	Time get_deadline() const {
+		return start_time_ + timeout_ + delay_acc_;
+	}
+
+	bool paused() const {
+		return paused_;
+	}
+
+	/*
+	 * Fills the timer fields so that they only change on start, pause and resume.
+	 * While running, clients compute the countdown from timer_deadline.
+	 */
+	void fill(Time const& now, roah_rsbb::ZoneState& zone) {
+		zone.timer = paused_ ? get_until_timeout(now) : timeout_;
+		zone.timer_deadline = get_deadline();
+		zone.timer_paused = paused_;
+		zone.timer_delay = delay_acc_;
+	}
 };
 
 #endif
@@ -31,6 +31,7 @@ using namespace rsbb_benchmarking_messages;
 class ExecutingBenchmark: boost::noncopyable {
 protected:
 	CoreSharedState& ss_;
+	NodeHandle& nh_;
 
 	Publisher timeout_pub_;
 
@@ -53,7 +54,8 @@ protected:
 
 	RsbbLog log_;
 
-	vector<ScoringItem> scoring_;
+	vector<int32_t> score_values_;
+	uint32_t score_version_;
 
 	void set_state(Time const& now, roah_rsbb_msgs::BenchmarkState::State const& state, string const& desc) {
 		state_ = state;
@@ -118,12 +120,18 @@ private:
 	}
 
 public:
-	ExecutingBenchmark(CoreSharedState& ss, Event const& event, boost::function<void()> end) :
-		ss_(ss), timeout_pub_(ss_.nh.advertise<std_msgs::Empty> ("/timeout", 1, false)), event_(event), display_log_(), display_online_data_(), phase_(PHASE_PRE),
-				stopped_due_to_timeout_(false), time_(ss, event_.benchmark.timeout, boost::bind(&ExecutingBenchmark::timeout_2, this)), manual_operation_(""),
-				log_(event.team, event.round, event.run, ss.run_uuid, display_log_), scoring_(event.benchmark.scoring), end_(end) {
+	ExecutingBenchmark(CoreSharedState& ss, NodeHandle& nh, Event const& event, boost::function<void()> end) :
+		ss_(ss), nh_(nh), timeout_pub_(nh_.advertise<std_msgs::Empty> ("/timeout", 1, false)), event_(event), display_log_(ss_.config.get().display_log_capacity), display_online_data_(ss_.config.get().display_log_capacity), phase_(PHASE_PRE),
+				stopped_due_to_timeout_(false), time_(nh_, ss_.scheduler, ss_.metrics.timeout_lateness, event_.benchmark->timeout, boost::bind(&ExecutingBenchmark::timeout_2, this)), manual_operation_(""),
+				log_(ss.config.get(), ss.metrics, event.team, event.round, event.run, ss.run_uuid, display_log_), score_values_(event.benchmark->scoring.size(), 0), score_version_(0), end_(end) {
 		Time now = Time::now();
 
+		roah_rsbb::ScoringSchema schema;
+		schema.benchmark = event_.benchmark->code;
+		schema.hash = event_.benchmark->scoring.hash();
+		event_.benchmark->scoring.msg(score_values_, schema.groups);
+		log_.log_scoring_schema("/rsbb_log/scoring_schema", now, schema);
+
 		set_state(now, roah_rsbb_msgs::BenchmarkState_State_STOP, "All OK for start");
 	}
 
@@ -141,17 +149,31 @@ public:
 
 	}
 
-	void set_score(roah_rsbb::Score const& score) {
+	bool set_scores(uint32_t schema, vector<roah_rsbb::Score> const& scores, uint32_t& version) {
 		Time now = Time::now();
 
-		for (ScoringItem& i : scoring_) {
-			if ( (score.group == i.group) && (score.desc == i.desc)) {
-				i.current_value = score.value;
-				log_.log_score ("/rsbb_log/score", now, score);
-				return;
+		ScoringSchema const& scoring = event_.benchmark->scoring;
+		if (schema != scoring.hash()) {
+			ROS_ERROR_STREAM("Ignored scores for outdated scoring schema " << schema << ", current is " << scoring.hash());
+			return false;
+		}
+		for (roah_rsbb::Score const& score : scores) {
+			if (! scoring.item(score.id)) {
+				ROS_ERROR_STREAM("Did not find scoring item " << score.id);
+				return false;
 			}
 		}
-		ROS_ERROR_STREAM("Did not find group " << score.group << " desc " << score.desc);
+
+		roah_rsbb::Scores msg;
+		msg.version = ++score_version_;
+		msg.scores = scores;
+		for (roah_rsbb::Score const& score : scores) {
+			score_values_[score.id] = score.value;
+		}
+		log_.log_scores ("/rsbb_log/scores", now, msg, scoring);
+
+		version = score_version_;
+		return true;
 	}
 
 	virtual void manual_operation_complete() {
@@ -204,13 +226,16 @@ public:
 	virtual void fill(Time const& now, roah_rsbb::ZoneState& zone) {
 		switch (phase_) {
 		case PHASE_PRE:
-			zone.timer = event_.benchmark.timeout;
+			zone.timer = event_.benchmark->timeout;
+			zone.timer_paused = true;
 			break;
 		case PHASE_EXEC:
-			zone.timer = time_.get_until_timeout(now);
+			time_.fill(now, zone);
 			break;
 		case PHASE_POST:
-			zone.timer = last_stop_time_ + Duration(param_direct<double> ("~after_stop_duration", 120.0)) - now;
+			zone.timer = ss_.config.get().after_stop_duration;
+			zone.timer_deadline = last_stop_time_ + zone.timer;
+			zone.timer_paused = false;
 			break;
 		}
 
@@ -221,29 +246,9 @@ public:
 		zone.start_enabled = state_ == roah_rsbb_msgs::BenchmarkState_State_STOP;
 		zone.stop_enabled = !zone.start_enabled && phase_ == PHASE_EXEC;
 
-		const size_t log_size = param_direct<int> ("~display_log_size", 3000);
-		zone.log = display_log_.last(log_size);
-		zone.online_data = display_online_data_.last(log_size);
-
-		for (ScoringItem const& i : scoring_) {
-			if (zone.scoring.empty() || (zone.scoring.back().group_name != i.group)) {
-				zone.scoring.push_back (roah_rsbb::ZoneScoreGroup());
-				zone.scoring.back().group_name = i.group;
-			}
-			switch (i.type) {
-				case ScoringItem::SCORING_BOOL:
-				zone.scoring.back().types.push_back (roah_rsbb::ZoneScoreGroup::SCORING_BOOL);
-				break;
-				case ScoringItem::SCORING_UINT:
-				zone.scoring.back().types.push_back (roah_rsbb::ZoneScoreGroup::SCORING_UINT);
-				break;
-				default:
-				ROS_FATAL_STREAM ("type in ScoringItem error");
-				abort_rsbb();
-			}
-			zone.scoring.back().descriptions.push_back (i.desc);
-			zone.scoring.back().current_values.push_back (i.current_value);
-		}
+		zone.scoring_schema = event_.benchmark->scoring.hash();
+		zone.score_version = score_version_;
+		event_.benchmark->scoring.msg(score_values_, zone.scoring);
 
 		fill_2(now, zone);
 	}
@@ -252,6 +257,11 @@ public:
 		return state_;
 	}
 
+	// Published by the zone as LogEntries, stream is LOG or ONLINE_DATA
+	DisplayText const& display_text(uint8_t stream) const {
+		return (stream == roah_rsbb::LogEntries::ONLINE_DATA) ? display_online_data_ : display_log_;
+	}
+
 	virtual void
 	stop_communication() = 0;
 };
@@ -260,13 +270,21 @@ class ExecutingSingleRobotBenchmark: public ExecutingBenchmark {
 protected:
 	string robot_name_;
 
+	// Declared before the channel, so the port is only returned after it is closed
+	CorePortPool::Lease private_port_;
 	unique_ptr<roah_rsbb::RosPrivateChannel> private_channel_;
 
 	roah_rsbb_msgs::Time ack_;
 	Duration last_skew_;
 	Time last_beacon_;
 
-	Timer state_timer_;
+	// Reused between transmissions, to keep its allocations
+	roah_rsbb_msgs::BenchmarkState state_msg_;
+
+	// Arrival of the last RobotState datagram, stamped in the channel thread
+	std::atomic<std::chrono::steady_clock::rep> robot_state_arrival_;
+	// Arrival of the oldest RobotState not yet acknowledged, 0 if none
+	std::chrono::steady_clock::rep ack_arrival_;
 
 	uint32_t messages_saved_;
 
@@ -281,36 +299,63 @@ protected:
 	virtual void fill_benchmark_state_2(roah_rsbb_msgs::BenchmarkState& msg) {
 	}
 
+	// Owner id of the callbacks of this benchmark in the zone queue
+	uint64_t owner_id() const {
+		return reinterpret_cast<uint64_t>(this);
+	}
+
 private:
-	void transmit_state(const TimerEvent& = TimerEvent()) {
+	roah_rsbb::RosPrivateChannel* open_private_channel() {
+		try {
+			return new roah_rsbb::RosPrivateChannel(ss_.config.get().rsbb_host, private_port_.port(), event_.password, ss_.config.get().rsbb_cypher);
+		} catch (boost::system::system_error const& e) {
+			// Only a port taken by another process is removed, other errors
+			// (bad host or cypher) return it to the pool with the lease
+			if (e.code() == boost::asio::error::address_in_use) {
+				private_port_.discard();
+			}
+			throw;
+		}
+	}
+
+	void transmit_state() {
 		ROS_DEBUG("Transmitting benchmark state");
 
-		roah_rsbb_msgs::BenchmarkState msg;
-		msg.set_benchmark_type(event_.benchmark_code);
-		msg.set_benchmark_state(state_);
-		(*(msg.mutable_acknowledgement())) = ack_;
-		fill_benchmark_state_2(msg);
-		private_channel_->send(msg);
+		state_msg_.Clear();
+		state_msg_.set_benchmark_type(event_.benchmark_code);
+		state_msg_.set_benchmark_state(state_);
+		(*(state_msg_.mutable_acknowledgement())) = ack_;
+		fill_benchmark_state_2(state_msg_);
+		private_channel_->send(state_msg_);
+
+		if (ack_arrival_) {
+			ss_.metrics.robot_state_ack.record(std::chrono::steady_clock::now() - std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ack_arrival_)));
+			ack_arrival_ = 0;
+		}
+	}
+
+	void stamp_robot_state() {
+		robot_state_arrival_.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
 	}
 
-	void receive_benchmark_state(boost::asio::ip::udp::endpoint endpoint, uint16_t comp_id, uint16_t msg_type, std::shared_ptr<const roah_rsbb_msgs::BenchmarkState> msg) {
+	void receive_benchmark_state(boost::asio::ip::udp::endpoint const& endpoint, uint16_t comp_id, uint16_t msg_type, roah_rsbb_msgs::BenchmarkState const& msg) {
 		ROS_ERROR_STREAM(
 				"Detected another RSBB transmitting in the private channel for team " << event_.team << ": " << endpoint.address().to_string() << ":" << endpoint.port()
 						<< ", COMP_ID " << comp_id << ", MSG_TYPE " << msg_type << endl);
 	}
 
-	void receive_robot_state(boost::asio::ip::udp::endpoint endpoint, uint16_t comp_id, uint16_t msg_type, std::shared_ptr<const roah_rsbb_msgs::RobotState> msg) {
+	void receive_robot_state(boost::asio::ip::udp::endpoint const& endpoint, uint16_t comp_id, uint16_t msg_type, roah_rsbb_msgs::RobotState const& msg) {
 		Time now = last_beacon_ = Time::now();
-		Time msg_time(msg->time().sec(), msg->time().nsec());
+		Time msg_time(msg.time().sec(), msg.time().nsec());
 		Duration last_skew_ = msg_time - now;
 
 		ROS_DEBUG_STREAM(
 				"Received RobotState from " << endpoint.address().to_string() << ":" << endpoint.port() << ", COMP_ID " << comp_id << ", MSG_TYPE " << msg_type << ", time: "
-						<< msg->time().sec() << "." << msg->time().nsec() << ", skew: " << last_skew_);
+						<< msg.time().sec() << "." << msg.time().nsec() << ", skew: " << last_skew_);
 
 		ss_.active_robots.add(event_.team, robot_name_, last_skew_, now);
 
-		messages_saved_ = msg->messages_saved();
+		messages_saved_ = msg.messages_saved();
 		/* if ( (messages_saved_ == 0) */
 		/*      && (param_direct<bool> ("~check_messages_saved", true)) */
 		/*      && ( (state_ == roah_rsbb_msgs::BenchmarkState_State_GOAL_TX) */
@@ -319,42 +364,74 @@ private:
 		/*   phase_post ("STOPPED BENCHMARK: Messages saved information received from robot is still 0!"); */
 		/* } */
 
-		ack_ = msg->time();
+		ack_ = msg.time();
+		if (!ack_arrival_) {
+			ack_arrival_ = robot_state_arrival_.load(std::memory_order_relaxed);
+		}
 
-		rcv_notifications_.receive(now, msg->notifications());
-		rcv_activation_event_.receive(now, msg->activation_event());
-		rcv_visitor_.receive(now, msg->visitor());
-		rcv_final_command_.receive(now, msg->final_command());
+		rcv_notifications_.receive(now, msg.notifications());
+		rcv_activation_event_.receive(now, msg.activation_event());
+		rcv_visitor_.receive(now, msg.visitor());
+		rcv_final_command_.receive(now, msg.final_command());
 
-		receive_robot_state_2(now, *msg);
+		receive_robot_state_2(now, msg);
 	}
 
 public:
-	ExecutingSingleRobotBenchmark(CoreSharedState& ss, Event const& event, boost::function<void()> end, string const& robot_name) :
-				ExecutingBenchmark(ss, event, end),
+	ExecutingSingleRobotBenchmark(CoreSharedState& ss, NodeHandle& nh, Event const& event, boost::function<void()> end, string const& robot_name) :
+				ExecutingBenchmark(ss, nh, event, end),
 				robot_name_(robot_name),
-				private_channel_(
-						new roah_rsbb::RosPrivateChannel(param_direct<string> ("~rsbb_host", "10.255.255.255"), ss_.private_port(), event_.password,
-								param_direct<string> ("~rsbb_cypher", "aes-128-cbc"))),
-				state_timer_(ss_.nh.createTimer(Duration(0.2), &ExecutingSingleRobotBenchmark::transmit_state, this)), messages_saved_(0),
+				private_port_(ss_.private_ports),
+				private_channel_(open_private_channel()),
+				robot_state_arrival_(0), ack_arrival_(0), messages_saved_(0),
 				rcv_notifications_(log_, "/notification", display_online_data_), rcv_activation_event_(log_, "/command", display_online_data_),
 				rcv_visitor_(log_, "/visitor", display_online_data_), rcv_final_command_(log_, "/command", display_online_data_) {
 		ack_.set_sec(0);
 		ack_.set_nsec(0);
-		private_channel_->set_benchmark_state_callback(&ExecutingSingleRobotBenchmark::receive_benchmark_state, this);
-		private_channel_->set_robot_state_callback(&ExecutingSingleRobotBenchmark::receive_robot_state, this);
+		ss_.transmitter.add(nh_.getCallbackQueue(), owner_id(), boost::bind(&ExecutingSingleRobotBenchmark::transmit_state, this));
+		// Stamped before being queued, for the robot_state_ack metric
+		private_channel_->signal_robot_state_received().connect(boost::bind(&ExecutingSingleRobotBenchmark::stamp_robot_state, this));
+		// Run the channel callbacks in the zone queue, with the other callbacks of this benchmark
+		connect_queued(private_channel_->signal_benchmark_state_received(), nh_.getCallbackQueue(), &ExecutingSingleRobotBenchmark::receive_benchmark_state, this);
+		connect_queued(private_channel_->signal_robot_state_received(), nh_.getCallbackQueue(), &ExecutingSingleRobotBenchmark::receive_robot_state, this);
+
+		std::lock_guard<std::mutex> lock(ss_.mutex);
 		ss_.benchmarking_robots[event_.team] = make_pair(robot_name_, private_channel_->port());
+		ss_.beacon_changed();
+	}
+
+	~ExecutingSingleRobotBenchmark() {
+		ss_.transmitter.remove(nh_.getCallbackQueue(), owner_id());
+		private_channel_.reset();
+		ss_.devices.cancel(owner_id());
+		nh_.getCallbackQueue()->removeByID(owner_id());
 	}
 
 	void stop_communication() {
-		state_timer_.stop();
+		ss_.transmitter.remove(nh_.getCallbackQueue(), owner_id());
 		private_channel_->signal_benchmark_state_received().disconnect_all_slots();
 		private_channel_->signal_robot_state_received().disconnect_all_slots();
-		ss_.benchmarking_robots.erase(event_.team);
+
+		std::lock_guard<std::mutex> lock(ss_.mutex);
+		if (ss_.benchmarking_robots.erase(event_.team)) {
+			ss_.beacon_changed();
+		}
 	}
 };
 
 class ExecutingSimpleBenchmark: public ExecutingSingleRobotBenchmark {
+	void set_device(Time const& now, CoreDevices::device_t device, uint8_t value) {
+		if (ss_.devices.set(device, value, nh_.getCallbackQueue(), owner_id(), boost::bind(&ExecutingSimpleBenchmark::device_done, this, device, _1, _2, _3))) {
+			log_.log_uint8("/rsbb_log/devices/" + CoreDevices::name(device), now, value);
+		}
+	}
+
+	void device_done(CoreDevices::device_t device, bool ok, uint8_t value, Duration const& latency) {
+		ostringstream o;
+		o << (ok ? "set " : "FAILED to set ") << static_cast<unsigned>(value) << " after " << latency.toSec() << " s";
+		log_.log_string("/rsbb_log/devices/" + CoreDevices::name(device) + "/result", Time::now(), o.str());
+	}
+
 	void receive_robot_state_2(Time const& now, roah_rsbb_msgs::RobotState const& msg) {
 		switch (state_) {
 		case roah_rsbb_msgs::BenchmarkState_State_STOP:
@@ -386,47 +463,43 @@ class ExecutingSimpleBenchmark: public ExecutingSingleRobotBenchmark {
 		}
 
 		if (event_.benchmark_code == "HCFGAC") {
-			if (msg.has_devices_switch_1() && (msg.devices_switch_1() != ss_.last_devices_state->switch_1)) {
-				roah_devices::Bool b;
-				b.request.data = msg.devices_switch_1();
-				call_service("/devices/switch_1/set", b);
-				log_.log_uint8("/rsbb_log/devices/switch_1", now, b.request.data ? 1 : 0);
+			roah_devices::DevicesState::ConstPtr devices_state;
+			{
+				std::lock_guard<std::mutex> lock(ss_.mutex);
+				devices_state = ss_.last_devices_state;
+			}
+
+			if (msg.has_devices_switch_1() && (msg.devices_switch_1() != devices_state->switch_1)) {
+				set_device(now, CoreDevices::SWITCH_1, msg.devices_switch_1() ? 1 : 0);
 			}
-			if (msg.has_devices_switch_2() && (msg.devices_switch_2() != ss_.last_devices_state->switch_2)) {
-				roah_devices::Bool b;
-				b.request.data = msg.devices_switch_2();
-				call_service("/devices/switch_2/set", b);
-				log_.log_uint8("/rsbb_log/devices/switch_2", now, b.request.data ? 1 : 0);
+			if (msg.has_devices_switch_2() && (msg.devices_switch_2() != devices_state->switch_2)) {
+				set_device(now, CoreDevices::SWITCH_2, msg.devices_switch_2() ? 1 : 0);
 			}
-			if (msg.has_devices_switch_3() && (msg.devices_switch_3() != ss_.last_devices_state->switch_3)) {
-				roah_devices::Bool b;
-				b.request.data = msg.devices_switch_3();
-				call_service("/devices/switch_3/set", b);
-				log_.log_uint8("/rsbb_log/devices/switch_3", now, b.request.data ? 1 : 0);
+			if (msg.has_devices_switch_3() && (msg.devices_switch_3() != devices_state->switch_3)) {
+				set_device(now, CoreDevices::SWITCH_3, msg.devices_switch_3() ? 1 : 0);
 			}
-			if (msg.has_devices_blinds() && (msg.devices_blinds() != ss_.last_devices_state->blinds)) {
-				roah_devices::Percentage p;
-				p.request.data = msg.devices_blinds();
-				call_service("/devices/blinds/set", p);
-				log_.log_uint8("/rsbb_log/devices/blinds", now, p.request.data);
+			if (msg.has_devices_blinds() && (msg.devices_blinds() != devices_state->blinds)) {
+				set_device(now, CoreDevices::BLINDS, msg.devices_blinds());
 			}
-			if (msg.has_devices_dimmer() && (msg.devices_dimmer() != ss_.last_devices_state->dimmer)) {
-				roah_devices::Percentage p;
-				p.request.data = msg.devices_dimmer();
-				call_service("/devices/dimmer/set", p);
-				log_.log_uint8("/rsbb_log/devices/dimmer", now, p.request.data);
+			if (msg.has_devices_dimmer() && (msg.devices_dimmer() != devices_state->dimmer)) {
+				set_device(now, CoreDevices::DIMMER, msg.devices_dimmer());
 			}
 
-			if (msg.has_tablet_display_map() && (ss_.tablet_display_map != msg.tablet_display_map())) {
-				ss_.tablet_display_map = msg.tablet_display_map();
-				log_.log_uint8("/rsbb_log/tablet/display_map", now, ss_.tablet_display_map ? 1 : 0);
+			if (msg.has_tablet_display_map()) {
+				std::unique_lock<std::mutex> lock(ss_.mutex);
+				if (ss_.tablet_display_map != msg.tablet_display_map()) {
+					ss_.tablet_display_map = msg.tablet_display_map();
+					ss_.beacon_changed();
+					lock.unlock();
+					log_.log_uint8("/rsbb_log/tablet/display_map", now, msg.tablet_display_map() ? 1 : 0);
+				}
 			}
 		}
 	}
 
 public:
-	ExecutingSimpleBenchmark(CoreSharedState& ss, Event const& event, boost::function<void()> end, string const& robot_name) :
-		ExecutingSingleRobotBenchmark(ss, event, end, robot_name) {
+	ExecutingSimpleBenchmark(CoreSharedState& ss, NodeHandle& nh, Event const& event, boost::function<void()> end, string const& robot_name) :
+		ExecutingSingleRobotBenchmark(ss, nh, event, end, robot_name) {
 	}
 
 	void fill_2(Time const& now, roah_rsbb::ZoneState& zone) {
@@ -436,7 +509,7 @@ public:
 			zone.state += "\nWARNING: Last clock skew above threshold: " + to_string(last_skew_.toSec());
 		}
 		if ((now - last_beacon_) > Duration(5)) {
-			zone.state += "\nWARNING: Last robot transmission received " + to_string((now - last_beacon_).toSec()) + " seconds ago";
+			zone.state += "\nWARNING: Last robot transmission received at " + to_string(Time(last_beacon_.sec, 0));
 		}
 	}
 };
@@ -506,7 +579,7 @@ class ExecutingExternallyControlledBenchmark: public ExecutingSingleRobotBenchma
 	string goal_execution_payload_;
 	string manual_operation_payload_;
 
-	Timer refbox_state_publish_timer_;
+	ScheduledTimer refbox_state_publish_timer_;
 	Publisher refbox_state_pub_;
 	Subscriber bmbox_state_sub_;
 
@@ -526,23 +599,24 @@ class ExecutingExternallyControlledBenchmark: public ExecutingSingleRobotBenchma
 
 
 public:
-	ExecutingExternallyControlledBenchmark(CoreSharedState& ss, Event const& event, boost::function<void()> end, string const& robot_name) :
-		ExecutingSingleRobotBenchmark(ss, event, end, robot_name),
+	ExecutingExternallyControlledBenchmark(CoreSharedState& ss, NodeHandle& nh, Event const& event, boost::function<void()> end, string const& robot_name) :
+		ExecutingSingleRobotBenchmark(ss, nh, event, end, robot_name),
 
-		execute_manual_operation_service_(ss_.nh.advertiseService("/execute_manual_operation", &ExecutingExternallyControlledBenchmark::execute_manual_operation_callback, this)),
-		execute_goal_service_(ss_.nh.advertiseService("/execute_goal", &ExecutingExternallyControlledBenchmark::execute_goal_callback, this)),
-		end_benchmark_service_(ss_.nh.advertiseService("/end_benchmark", &ExecutingExternallyControlledBenchmark::end_benchmark_callback, this)),
+		execute_manual_operation_service_(nh_.advertiseService("/execute_manual_operation", &ExecutingExternallyControlledBenchmark::execute_manual_operation_callback, this)),
+		execute_goal_service_(nh_.advertiseService("/execute_goal", &ExecutingExternallyControlledBenchmark::execute_goal_callback, this)),
+		end_benchmark_service_(nh_.advertiseService("/end_benchmark", &ExecutingExternallyControlledBenchmark::end_benchmark_callback, this)),
 
-		refbox_state_publish_timer_(ss_.nh.createTimer(Duration(0.2), &ExecutingExternallyControlledBenchmark::refbox_state_publish_timer_callback, this)),
-		refbox_state_pub_(ss_.nh.advertise<RefBoxState> (bmbox_prefix(event) + "refbox_state", 1, true)),
-		bmbox_state_sub_(ss_.nh.subscribe(bmbox_prefix(event) + "bmbox_state", 1, &ExecutingExternallyControlledBenchmark::bmbox_state_callback, this)),
+		refbox_state_publish_timer_(ss_.scheduler, nh_.getCallbackQueue(), boost::bind(&ExecutingExternallyControlledBenchmark::refbox_state_publish_timer_callback, this, TimerEvent())),
+		refbox_state_pub_(nh_.advertise<RefBoxState> (bmbox_prefix(event) + "refbox_state", 1, true)),
+		bmbox_state_sub_(nh_.subscribe(bmbox_prefix(event) + "bmbox_state", 1, &ExecutingExternallyControlledBenchmark::bmbox_state_callback, this)),
 
-		time_(ss, event_.benchmark.timeout, true, boost::bind(&ExecutingExternallyControlledBenchmark::goal_timeout_callback, this)),
-		global_timeout_(ss, event_.benchmark.total_timeout, true, boost::bind(&ExecutingExternallyControlledBenchmark::global_timeout_callback, this)),
+		time_(nh_, ss_.scheduler, ss_.metrics.timeout_lateness, event_.benchmark->timeout, true, boost::bind(&ExecutingExternallyControlledBenchmark::goal_timeout_callback, this)),
+		global_timeout_(nh_, ss_.scheduler, ss_.metrics.timeout_lateness, event_.benchmark->total_timeout, true, boost::bind(&ExecutingExternallyControlledBenchmark::global_timeout_callback, this)),
 
 		last_bmbox_state_(boost::make_shared<BmBoxState>())
 	{
-		cout << endl << endl << endl << endl << endl << endl << endl << endl << "STARTING BENCHMARK: " << event.benchmark.code << endl << event << endl << endl << endl;
+		refbox_state_publish_timer_.start(Duration(0.2), Duration(0.2));
+		cout << endl << endl << endl << endl << endl << endl << endl << endl << "STARTING BENCHMARK: " << event.benchmark->code << endl << event << endl << endl << endl;
 	}
 
 
@@ -588,16 +662,16 @@ public:
 			time_.start_reset(now, Duration(current_goal_timeout_));
 			cout << "start_goal_execution: setting bmbox timeout:\t" << to_qstring(time_.get_until_timeout(Time::now())).toStdString() << endl;
 
-		} else if (event_.benchmark.timeout < event_.benchmark.total_timeout) {
+		} else if (event_.benchmark->timeout < event_.benchmark->total_timeout) {
 
 			// else, if a goal timeout is specified in the configuration then use this one
-			time_.start_reset(now, event_.benchmark.timeout);
+			time_.start_reset(now, event_.benchmark->timeout);
 			cout << "start_goal_execution: setting default goal timeout:\t" << to_qstring(time_.get_until_timeout(Time::now())).toStdString() << endl;
 
 		} else {
 
 			// otherwise use the total timeout
-			time_.start_reset(now, event_.benchmark.total_timeout);
+			time_.start_reset(now, event_.benchmark->total_timeout);
 			cout << "start_goal_execution: setting default total timeout:\t" << to_qstring(time_.get_until_timeout(Time::now())).toStdString() << endl;
 		}
 
@@ -699,9 +773,9 @@ public:
 	void fill(Time const& now, roah_rsbb::ZoneState& zone) {
 
 		switch (phase_) {
-		case PHASE_PRE:		zone.timer = event_.benchmark.timeout; break;
-		case PHASE_EXEC:	zone.timer = time_.get_until_timeout(now); break;
-		case PHASE_POST:	break;
+		case PHASE_PRE:		zone.timer = event_.benchmark->timeout; zone.timer_paused = true; break;
+		case PHASE_EXEC:	time_.fill(now, zone); break;
+		case PHASE_POST:	zone.timer_paused = true; break;
 		}
 
 		zone.state = state_desc_;
@@ -711,33 +785,16 @@ public:
 		zone.start_enabled = (phase_ == PHASE_PRE) && (bmbox_state_sub_.getNumPublishers() > 0);
 		zone.stop_enabled = !zone.start_enabled;
 
-		const size_t log_size = param_direct<int> ("~display_log_size", 3000);
-		zone.log = display_log_.last(log_size);
-		zone.online_data = display_online_data_.last(log_size);
-
-		if (phase_ == PHASE_EXEC) add_to_sting(zone.state) << "Benchmark timeout: " << to_qstring(global_timeout_.get_until_timeout(Time::now())).toStdString();
+		if (phase_ == PHASE_EXEC) {
+			if (global_timeout_.paused()) add_to_sting(zone.state) << "Benchmark timeout: " << to_qstring(global_timeout_.get_until_timeout(now)).toStdString();
+			else add_to_sting(zone.state) << "Benchmark timeout at: " << to_string(Time(global_timeout_.get_deadline().sec, 0));
+		}
 
 		if (bmbox_state_sub_.getNumPublishers() > 1) add_to_sting(zone.state) << "WARNING: connected to multiple BmBox scripts";
 
-		for (ScoringItem const& i : scoring_) {
-			if (zone.scoring.empty() || (zone.scoring.back().group_name != i.group)) {
-				zone.scoring.push_back (roah_rsbb::ZoneScoreGroup());
-				zone.scoring.back().group_name = i.group;
-			}
-			switch (i.type) {
-				case ScoringItem::SCORING_BOOL:
-				zone.scoring.back().types.push_back (roah_rsbb::ZoneScoreGroup::SCORING_BOOL);
-				break;
-				case ScoringItem::SCORING_UINT:
-				zone.scoring.back().types.push_back (roah_rsbb::ZoneScoreGroup::SCORING_UINT);
-				break;
-				default:
-				ROS_FATAL_STREAM ("type in ScoringItem error");
-				abort_rsbb();
-			}
-			zone.scoring.back().descriptions.push_back (i.desc);
-			zone.scoring.back().current_values.push_back (i.current_value);
-		}
+		zone.scoring_schema = event_.benchmark->scoring.hash();
+		zone.score_version = score_version_;
+		event_.benchmark->scoring.msg(score_values_, zone.scoring);
 	}
 
 	void fill_2(Time const& now, roah_rsbb::ZoneState& zone){}
@@ -869,6 +926,7 @@ public:
 	 ************************************************/
 
 	bool execute_manual_operation_callback(ExecuteManualOperation::Request& req, ExecuteManualOperation::Response& res) {
+		ScopedLatency latency(ss_.metrics.bmbox_callback);
 		printStates();
 
 		res.result.data = false;
@@ -890,6 +948,7 @@ public:
 	}
 
 	bool execute_goal_callback(ExecuteGoal::Request& req, ExecuteGoal::Response& res) {
+		ScopedLatency latency(ss_.metrics.bmbox_callback);
 		printStates();
 
 		Time now = Time::now();
@@ -937,6 +996,7 @@ public:
 	 * Called by the benchmark script when the benchmark is ended and it can be terminated
 	 */
 	bool end_benchmark_callback(EndBenchmark::Request& req, EndBenchmark::Response& res) {
+		ScopedLatency latency(ss_.metrics.bmbox_callback);
 		printStates();
 
 		Time now = Time::now();
@@ -960,6 +1020,7 @@ public:
 	}
 
 	void bmbox_state_callback(BmBoxState::ConstPtr const& msg) {
+		ScopedLatency latency(ss_.metrics.bmbox_callback);
 
 		printStates();
 		if (msg->state == last_bmbox_state_->state) return;
@@ -1161,10 +1222,10 @@ public:
 private:
 	string bmbox_prefix(Event const& event) {
 
-		if(event.benchmark.prefix.length()){
-			return "/" + event.benchmark.prefix + "/";
+		if(event.benchmark->prefix.length()){
+			return "/" + event.benchmark->prefix + "/";
 		} else {
-			ROS_FATAL_STREAM("Cannot execute benchmark of type " << event.benchmark_code << "(" << event.benchmark.desc << ") with ExecutingExternallyControlledBenchmark");
+			ROS_FATAL_STREAM("Cannot execute benchmark of type " << event.benchmark_code << "(" << event.benchmark->desc << ") with ExecutingExternallyControlledBenchmark");
 			terminate_benchmark();
 			return "/";
 		}
@@ -1181,7 +1242,8 @@ private:
 
 
 class ExecutingAllRobotsBenchmark: public ExecutingBenchmark {
-	vector<Event> dummy_events_;
+	// Not a vector, the benchmarks keep references to these
+	deque<Event> dummy_events_;
 	vector<unique_ptr<ExecutingSimpleBenchmark>> simple_benchmarks_;
 
 	void phase_exec_2(Time const& now) {
@@ -1205,32 +1267,39 @@ end()
 
 public:
 ExecutingAllRobotsBenchmark (CoreSharedState& ss,
+		NodeHandle& nh,
 		Event const& event,
 		boost::function<void() > end)
-: ExecutingBenchmark (ss, event, end)
+: ExecutingBenchmark (ss, nh, event, end)
 {
-	for (roah_rsbb::RobotInfo const& ri : ss_.active_robots.get ()) {
-		if (ss_.benchmarking_robots.count (ri.team)) {
-			ROS_ERROR_STREAM ("Ignoring robot of team " << ri.team << " because it is already executing a benchmark");
+	for (roah_rsbb::RobotInfo::ConstPtr const& ri : ss_.active_robots.get ()) {
+		bool busy;
+		{
+			std::lock_guard<std::mutex> lock (ss_.mutex);
+			busy = ss_.benchmarking_robots.count (ri->team);
+		}
+		if (busy) {
+			ROS_ERROR_STREAM ("Ignoring robot of team " << ri->team << " because it is already executing a benchmark");
+			continue;
+		}
+
+		Passwords const& passwords = ss_.passwords.get();
+		if (! passwords.has (ri->team)) {
+			ROS_ERROR_STREAM ("Ignoring robot of team " << ri->team << " because it has no password");
 			continue;
 		}
 
 		dummy_events_.push_back (event);
-		dummy_events_.back().team = ri.team;
-		dummy_events_.back().password = ss_.passwords.get (dummy_events_.back().team);
-
-		bool ok = false;
-		do {
-			try {
-				simple_benchmarks_.push_back (unique_ptr<ExecutingSimpleBenchmark> (new ExecutingSimpleBenchmark (ss, dummy_events_.back(), &ExecutingAllRobotsBenchmark::end, ri.robot)));
-				ok = true;
-			}
-			catch (const std::exception& exc) {
-				std::cerr << exc.what();
-				ROS_ERROR_STREAM ("Failed to create a private channel. Retrying on next port.");
-			}
+		dummy_events_.back().team = ri->team;
+		dummy_events_.back().password = passwords.get (dummy_events_.back().team);
+
+		try {
+			simple_benchmarks_.push_back (unique_ptr<ExecutingSimpleBenchmark> (new ExecutingSimpleBenchmark (ss, nh, dummy_events_.back(), &ExecutingAllRobotsBenchmark::end, ri->robot)));
+		}
+		catch (const std::exception& exc) {
+			ROS_ERROR_STREAM ("Ignoring robot of team " << ri->team << " because its private channel could not be created: " << exc.what());
+			dummy_events_.pop_back();
 		}
-		while (! ok);
 	}
 }
 
@@ -28,83 +28,220 @@
 
 
 
+typedef multimap<Time, const Event> ZoneEvents;
+
+
+
+/*
+ * Whether a and b are the same run of the same benchmark, as a reloaded
+ * schedule has new Event instances.
+ */
+inline bool
+same_event (Event const& a,
+            Event const& b)
+{
+  return (a.benchmark_code == b.benchmark_code)
+         && (a.team == b.team)
+         && (a.round == b.round)
+         && (a.run == b.run);
+}
+
+
+
+inline bool
+same_events (ZoneEvents const& a,
+             ZoneEvents const& b)
+{
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (auto i = a.cbegin(), j = b.cbegin(); i != a.cend(); ++i, ++j) {
+    if ( (i->first != j->first)
+         || ! same_event (i->second, j->second)
+         || (i->second.password != j->second.password)
+         || ! same_benchmark (*i->second.benchmark, *j->second.benchmark)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+
+/*
+ * Each zone runs in its own thread: the callbacks of the zone and of its
+ * executing benchmark all go through queue_, so they never run concurrently
+ * with each other and a slow zone does not delay the others. Other threads
+ * must use post() to call the methods of the zone, and read its state from
+ * the snapshot returned by msg(). A zone removed by a reload is destroyed
+ * by CoreZoneManager, never in its own thread, once no one else holds it.
+ */
 class Zone
   : boost::noncopyable
 {
     CoreSharedState& ss_;
 
+    CallbackQueue queue_;
+    NodeHandle nh_;
+    AsyncSpinner spinner_;
+
     string name_;
-    multimap<Time, const Event> events_;
-    multimap<Time, const Event>::const_iterator current_event_;
+    // Only replaced in the zone thread, other threads use std::atomic_load.
+    // Executing benchmarks reference the current events, so they are not
+    // replaced while executing.
+    shared_ptr<const ZoneEvents> events_;
+    ZoneEvents::const_iterator current_event_;
+    shared_ptr<const ZoneEvents> pending_events_;
 
     unique_ptr<ExecutingBenchmark> executing_benchmark_;
 
-  public:
-    typedef std::shared_ptr<Zone> Ptr;
+    // Whether executing_benchmark_ is set, and whether the zone was removed
+    // by a reload, so the decision to remove does not race with CONNECT
+    std::mutex removal_mutex_;
+    bool executing_;
+    bool removed_;
+
+    Timer snapshot_timer_;
+    std::mutex snapshot_mutex_;
+    roah_rsbb::ZoneState snapshot_;
+    std::atomic<Event const*> running_event_;
+
+    // Last entry collected from each stream of display text
+    struct LogCursor {
+      uint64_t epoch;
+      uint64_t seq;
+    };
+    LogCursor log_cursors_[2];
+    // Collected, not yet taken by take_log(). Guarded by snapshot_mutex_
+    vector<roah_rsbb::LogEntries> new_log_;
+
+    // Newest ~display_log_size characters of each stream, as collected, so
+    // backlog() does not need the zone thread. Guarded by snapshot_mutex_
+    struct BacklogText {
+      uint64_t epoch;
+      uint64_t first_seq;
+      deque<string> entries;
+      size_t size;
+    };
+    BacklogText log_backlogs_[2];
 
-    Zone (CoreSharedState& ss,
-          YAML::Node const& zone_node)
-      : ss_ (ss)
+    void
+    add_backlog (roah_rsbb::LogEntries const& log,
+                 size_t length)
     {
-      if (! zone_node["zone"]) {
-        ROS_FATAL_STREAM ("Schedule file is missing a \"zone\" entry!");
-        abort_rsbb();
+      BacklogText& backlog = log_backlogs_[log.stream];
+      if ( (log.epoch != backlog.epoch)
+           || (log.first_seq != backlog.first_seq + backlog.entries.size())) {
+        backlog.epoch = log.epoch;
+        backlog.first_seq = log.first_seq;
+        backlog.entries.clear();
+        backlog.size = 0;
       }
-      name_ = zone_node["zone"].as<string>();
-
-      if (! zone_node["schedule"]) {
-        ROS_FATAL_STREAM ("Schedule file is missing a \"schedule\" entry!");
-        abort_rsbb();
+      for (string const& entry : log.entries) {
+        backlog.entries.push_back (entry);
+        backlog.size += entry.size();
       }
-      if (! zone_node["schedule"].IsSequence()) {
-        ROS_FATAL_STREAM ("Schedule in schedule file is not a sequence!");
-        abort_rsbb();
+      // Always keep the newest entry, as DisplayText does
+      while ( (backlog.size > length) && (backlog.entries.size() > 1)) {
+        backlog.size -= backlog.entries.front().size();
+        backlog.entries.pop_front();
+        ++backlog.first_seq;
       }
-      for (YAML::Node const& event_node : zone_node["schedule"]) {
-        Event e = Event (event_node);
-        e.benchmark = ss_.benchmarks.get (e.benchmark_code);
-        if (e.team != "ALL") {
-          e.password = ss_.passwords.get (e.team);
-        }
-        events_.insert (make_pair (e.scheduled_time, e));
-
-        if (! ( (e.benchmark_code == "HGTKMH")
-                || (e.benchmark_code == "HWV")
-                || (e.benchmark_code == "HCFGAC")
-                || (e.benchmark_code == "HOPF")
-                || (e.benchmark_code == "HNF")
-                || (e.benchmark_code == "HSUF")
-                || (e.benchmark_code == "STB"))) {
-          ROS_FATAL_STREAM ("Zone " << name_ << ": unsupported benchmark code " << e.benchmark_code);
-          abort_rsbb();
-        }
+    }
 
-        if (e.benchmark_code == "HSUF") {
-          if (e.team != "ALL") {
-            ROS_FATAL_STREAM ("Zone " << name_ << ": benchmark code HSUF only supported for team ALL");
-            abort_rsbb();
-          }
-        }
+    DisplayText const*
+    display_text (uint8_t stream) const
+    {
+      return executing_benchmark_ ? &executing_benchmark_->display_text (stream) : nullptr;
+    }
 
-        if ( (e.benchmark_code == "HGTKMH")
-             || (e.benchmark_code == "HWV")
-             || (e.benchmark_code == "HCFGAC")
-             || (e.benchmark_code == "HOPF")
-             || (e.benchmark_code == "HNF")
-             || (e.benchmark_code == "STB")) {
-          if (e.team == "ALL") {
-            ROS_FATAL_STREAM ("Zone " << name_ << ": benchmark code " << e.benchmark_code << " not supported for team ALL");
-            abort_rsbb();
-          }
-        }
+    void
+    collect_log (uint8_t stream,
+                 vector<roah_rsbb::LogEntries>& out)
+    {
+      DisplayText const* text = display_text (stream);
+      LogCursor& cursor = log_cursors_[stream];
+      uint64_t epoch = text ? text->epoch() : 0;
+      if (epoch != cursor.epoch) {
+        // Sent even if empty, so clients clear the previous text
+        cursor.epoch = epoch;
+        cursor.seq = 0;
+      }
+      else if ( (! text) || (text->seq() == cursor.seq)) {
+        return;
       }
 
-      if (events_.empty()) {
-        ROS_FATAL_STREAM ("Zone " << name_ << " has no schedule defined");
-        abort_rsbb();
+      out.emplace_back();
+      roah_rsbb::LogEntries& entries = out.back();
+      entries.zone = name_;
+      entries.stream = stream;
+      entries.epoch = epoch;
+      entries.first_seq = text ? text->since (cursor.seq, entries.entries) : 0;
+      cursor.seq = text ? text->seq() : 0;
+    }
+
+    void
+    update_snapshot (const TimerEvent& = TimerEvent())
+    {
+      roah_rsbb::ZoneState zone = build_msg (Time::now());
+      vector<roah_rsbb::LogEntries> log;
+      collect_log (roah_rsbb::LogEntries::LOG, log);
+      collect_log (roah_rsbb::LogEntries::ONLINE_DATA, log);
+      size_t backlog_length = ss_.config.get().display_log_size;
+
+      std::lock_guard<std::mutex> lock (snapshot_mutex_);
+      snapshot_ = move (zone);
+      running_event_.store (executing_benchmark_ ? &current_event_->second : nullptr);
+      for (auto& i : log) {
+        add_backlog (i, backlog_length);
+        new_log_.push_back (move (i));
       }
+    }
+
+    void
+    run (boost::function<void()> const& f)
+    {
+      f();
+      update_snapshot();
+    }
 
-      current_event_ = events_.cbegin();
+    bool
+    benchmarking (string const& team)
+    {
+      std::lock_guard<std::mutex> lock (ss_.mutex);
+      return ss_.benchmarking_robots.count (team);
+    }
+
+  public:
+    typedef std::shared_ptr<Zone> Ptr;
+
+    Zone (CoreSharedState& ss,
+          string const& name,
+          shared_ptr<const ZoneEvents> const& events)
+      : ss_ (ss)
+      , spinner_ (1, &queue_)
+      , name_ (name)
+      , events_ (events)
+      , executing_ (false)
+      , removed_ (false)
+      , running_event_ (nullptr)
+      , log_cursors_ { {0, 0}, {0, 0} }
+      , log_backlogs_ { {0, 0, {}, 0}, {0, 0, {}, 0} }
+    {
+      nh_.setCallbackQueue (&queue_);
+
+      current_event_ = events->cbegin();
+
+      update_snapshot();
+      snapshot_timer_ = nh_.createTimer (Duration (0.1), &Zone::update_snapshot, this);
+      spinner_.start();
+    }
+
+    ~Zone()
+    {
+      spinner_.stop();
+      snapshot_timer_.stop();
+      executing_benchmark_.reset();
     }
 
     string
@@ -113,14 +250,106 @@ class Zone
       return name_;
     }
 
+    /*
+     * Runs f in the zone thread. f must not hold a Zone::Ptr, as releasing
+     * the last one in the zone thread would destroy the zone from within
+     * its own queue.
+     */
+    void
+    post (boost::function<void()> const& f)
+    {
+      queue_.addCallback (boost::make_shared<roah_rsbb::CallbackItem> (boost::bind (&Zone::run, this, f)));
+    }
+
     void
     end()
     {
-      getGlobalCallbackQueue()->addCallback (boost::make_shared<roah_rsbb::CallbackItem> (boost::bind (&unique_ptr<ExecutingBenchmark>::reset, &executing_benchmark_, nullptr)));
+      post (boost::bind (&Zone::finish, this));
+    }
+
+    void
+    finish()
+    {
+      {
+        std::lock_guard<std::mutex> lock (removal_mutex_);
+        executing_benchmark_.reset();
+        executing_ = false;
+      }
+      if (pending_events_) {
+        set_events (pending_events_);
+      }
+    }
+
+    /*
+     * Replaces the schedule, keeping the current event selected if it is
+     * still there. While a benchmark is executing this is delayed until it
+     * ends, and a later call replaces or drops the delayed schedule.
+     */
+    void
+    set_events (shared_ptr<const ZoneEvents> events)
+    {
+      if (same_events (*events_, *events)) {
+        if (pending_events_) {
+          ROS_INFO_STREAM ("Zone: " << name() << " pending schedule update dropped");
+          pending_events_.reset();
+        }
+        return;
+      }
+      if (executing_benchmark_) {
+        ROS_WARN_STREAM ("Zone: " << name() << " schedule will be updated when the benchmark ends");
+        pending_events_ = events;
+        return;
+      }
+      pending_events_.reset();
+
+      Event const& current = current_event_->second;
+      current_event_ = find_if (events->cbegin(), events->cend(),
+                                [&current] (ZoneEvents::value_type const& i) {
+                                  return same_event (i.second, current);
+                                });
+      if (current_event_ == events->cend()) {
+        current_event_ = events->lower_bound (current.scheduled_time);
+        if (current_event_ == events->cend()) {
+          current_event_ = prev (events->cend());
+        }
+      }
+
+      std::atomic_store (&events_, events);
+      ++ss_.schedule_version;
+
+      ROS_INFO_STREAM ("Zone: " << name() << " schedule updated");
     }
 
     void
     connect()
+    {
+      std::lock_guard<std::mutex> lock (removal_mutex_);
+      if (removed_) {
+        ROS_WARN_STREAM ("Zone: " << name() << " CONNECT ignored because the zone was removed");
+        return;
+      }
+      create_benchmark();
+      executing_ = static_cast<bool> (executing_benchmark_);
+    }
+
+    /*
+     * Can be called from any thread. Returns false if a benchmark is
+     * executing; otherwise the zone refuses any later CONNECT.
+     */
+    bool
+    try_remove()
+    {
+      std::lock_guard<std::mutex> lock (removal_mutex_);
+      if (executing_) {
+        return false;
+      }
+      removed_ = true;
+      return true;
+    }
+
+  private:
+    void
+    create_benchmark()
     {
       if (executing_benchmark_) {
         ROS_WARN_STREAM ("Zone: " << name() << " CONNECT (already issued)");
@@ -135,49 +364,45 @@ class Zone
           abort_rsbb();
         }
 
-        executing_benchmark_.reset (new ExecutingAllRobotsBenchmark (ss_, current_event_->second, boost::bind (&Zone::end, this)));
+        executing_benchmark_.reset (new ExecutingAllRobotsBenchmark (ss_, nh_, current_event_->second, boost::bind (&Zone::end, this)));
 
         return;
       }
 
-      roah_rsbb::RobotInfo ri = ss_.active_robots.get (current_event_->second.team);
-      if (ri.team.empty()) {
+      roah_rsbb::RobotInfo::ConstPtr ri = ss_.active_robots.get (current_event_->second.team);
+      if (! ri) {
         ROS_WARN_STREAM ("Zone: " << name() << " CONNECT ignored because robot not present");
         return;
       }
 
-      if (ss_.benchmarking_robots.count (current_event_->second.team)) {
+      if (benchmarking (current_event_->second.team)) {
         ROS_ERROR_STREAM ("Zone: " << name() << " CONNECT ignored because robot of team " << current_event_->second.team << " is already executing a benchmark");
         return;
       }
 
-      bool ok = false;
-      do {
-        try {
-          if ( (current_event_->second.benchmark_code == "HGTKMH")
-               || (current_event_->second.benchmark_code == "HWV")
-               || (current_event_->second.benchmark_code == "HCFGAC")) {
-            executing_benchmark_.reset (new ExecutingSimpleBenchmark (ss_, current_event_->second, boost::bind (&Zone::end, this), ri.robot));
-          }
-          else if ( (current_event_->second.benchmark_code == "HOPF")
+      try {
+        if ( (current_event_->second.benchmark_code == "HGTKMH")
+             || (current_event_->second.benchmark_code == "HWV")
+             || (current_event_->second.benchmark_code == "HCFGAC")) {
+          executing_benchmark_.reset (new ExecutingSimpleBenchmark (ss_, nh_, current_event_->second, boost::bind (&Zone::end, this), ri->robot));
+        }
+        else if ( (current_event_->second.benchmark_code == "HOPF")
                   || (current_event_->second.benchmark_code == "HNF")
                   || (current_event_->second.benchmark_code == "STB")) {
-            executing_benchmark_.reset (new ExecutingExternallyControlledBenchmark (ss_, current_event_->second, boost::bind (&Zone::end, this), ri.robot));
-          }
-          else {
-            ROS_FATAL_STREAM ("Zone " << name_ << " unsupported benchmark code: " << current_event_->second.benchmark_code);
-            abort_rsbb();
-          }
-          ok = true;
+          executing_benchmark_.reset (new ExecutingExternallyControlledBenchmark (ss_, nh_, current_event_->second, boost::bind (&Zone::end, this), ri->robot));
         }
-        catch (const std::exception& exc) {
-          std::cerr << exc.what();
-          ROS_ERROR_STREAM ("Failed to create a private channel. Retrying on next port.");
+        else {
+          ROS_FATAL_STREAM ("Zone " << name_ << " unsupported benchmark code: " << current_event_->second.benchmark_code);
+          abort_rsbb();
         }
       }
-      while (! ok);
+      catch (const std::exception& exc) {
+        ROS_ERROR_STREAM ("Zone: " << name() << " CONNECT failed to create the private channel: " << exc.what());
+      }
     }
 
+  public:
+
     void
     disconnect()
     {
@@ -190,16 +415,18 @@ class Zone
       executing_benchmark_->terminate_benchmark();
     }
 
-    void
-    set_score (roah_rsbb::Score const& score)
+    bool
+    set_scores (uint32_t schema,
+                vector<roah_rsbb::Score> const& scores,
+                uint32_t& version)
     {
       if (! executing_benchmark_) {
-        ROS_WARN_STREAM ("Zone: " << name() << " SET_SCORE (not executing, ignored)");
-        return;
+        ROS_WARN_STREAM ("Zone: " << name() << " SET_SCORES (not executing, ignored)");
+        return false;
       }
 
-      ROS_DEBUG_STREAM ("Zone: " << name() << " SET_SCORE");
-      executing_benchmark_->set_score (score);
+      ROS_DEBUG_STREAM ("Zone: " << name() << " SET_SCORES");
+      return executing_benchmark_->set_scores (schema, scores, version);
     }
 
     void
@@ -295,7 +522,7 @@ class Zone
 
       ROS_DEBUG_STREAM ("Zone: " << name() << " PREVIOUS");
 
-      if (current_event_ != events_.cbegin()) {
+      if (current_event_ != events_->cbegin()) {
         --current_event_;
       }
     }
@@ -310,22 +537,22 @@ class Zone
 
       ROS_DEBUG_STREAM ("Zone: " << name() << " NEXT");
 
-      if (current_event_ != prev (events_.cend())) {
+      if (current_event_ != prev (events_->cend())) {
         ++current_event_;
       }
     }
 
     roah_rsbb::ZoneState
-    msg (Time const& now)
+    build_msg (Time const& now)
     {
       roah_rsbb::ZoneState zone;
 
       zone.zone = name();
 
-      zone.name = current_event_->second.benchmark.name;
-      zone.desc = current_event_->second.benchmark.desc;
-      zone.code = current_event_->second.benchmark.code;
-      zone.timeout = current_event_->second.benchmark.timeout;
+      zone.name = current_event_->second.benchmark->name;
+      zone.desc = current_event_->second.benchmark->desc;
+      zone.code = current_event_->second.benchmark->code;
+      zone.timeout = current_event_->second.benchmark->timeout;
       zone.team = current_event_->second.team;
       zone.round = current_event_->second.round;
       zone.run = current_event_->second.run;
@@ -340,19 +567,20 @@ class Zone
         zone.next_enabled = false;
       }
       else {
-        zone.timer = current_event_->second.benchmark.timeout;
+        zone.timer = current_event_->second.benchmark->timeout;
+        zone.timer_paused = true;
         zone.state = "";
         zone.manual_operation = "";
 
         zone.start_enabled = false;
         zone.stop_enabled = false;
 
-        Duration allowed_skew = Duration (param_direct<double> ("~allowed_skew", 0.5));
-        if (current_event_->second.benchmark.code == "HSUF") {
+        Duration allowed_skew = ss_.config.get().allowed_skew;
+        if (current_event_->second.benchmark->code == "HSUF") {
           vector<string> teams_out_of_sync;
-          for (roah_rsbb::RobotInfo const& ri : ss_.active_robots.get ()) {
-            if ( ( (-allowed_skew) >= ri.skew) || (ri.skew >= allowed_skew)) {
-              teams_out_of_sync.push_back (ri.team);
+          for (roah_rsbb::RobotInfo::ConstPtr const& ri : ss_.active_robots.get ()) {
+            if ( ( (-allowed_skew) >= ri->skew) || (ri->skew >= allowed_skew)) {
+              teams_out_of_sync.push_back (ri->team);
             }
           }
           if (teams_out_of_sync.empty()) {
@@ -368,52 +596,96 @@ class Zone
             }
           }
         }
-        else if (ss_.benchmarking_robots.count (current_event_->second.team)) {
+        else if (benchmarking (current_event_->second.team)) {
           zone.connect_enabled = false;
           add_to_sting (zone.state) << "Robot is already executing another benchmark";
         }
         else {
-          roah_rsbb::RobotInfo ri = ss_.active_robots.get (current_event_->second.team);
-          if (ri.team.empty()) {
+          roah_rsbb::RobotInfo::ConstPtr ri = ss_.active_robots.get (current_event_->second.team);
+          if (! ri) {
             zone.connect_enabled = false;
             add_to_sting (zone.state) << "Robot not detected as active";
           }
           else {
-            if ( ( (-allowed_skew) < ri.skew) && (ri.skew < allowed_skew)) {
+            if ( ( (-allowed_skew) < ri->skew) && (ri->skew < allowed_skew)) {
               zone.connect_enabled = true;
               add_to_sting (zone.state) << "Robot ready to accept connection";
             }
             else {
               zone.connect_enabled = false;
-              add_to_sting (zone.state) << "Clock skew too large: " + boost::lexical_cast<string> (ri.skew);
+              add_to_sting (zone.state) << "Clock skew too large: " + boost::lexical_cast<string> (ri->skew);
             }
           }
         }
 
         zone.disconnect_enabled = false;
-        zone.prev_enabled = current_event_ != events_.cbegin();
-        zone.next_enabled = current_event_ != prev (events_.cend());
+        zone.prev_enabled = current_event_ != events_->cbegin();
+        zone.next_enabled = current_event_ != prev (events_->cend());
       }
 
       return zone;
     }
 
+    /*
+     * Can be called from any thread.
+     */
+    roah_rsbb::ZoneState
+    msg()
+    {
+      std::lock_guard<std::mutex> lock (snapshot_mutex_);
+      return snapshot_;
+    }
+
+    /*
+     * Can be called from any thread. Moves the display text entries added
+     * since the last call to out, in order.
+     */
     void
-    msg (Time const& now,
-         multimap<Time, roah_rsbb::ScheduleInfo>& map)
+    take_log (vector<roah_rsbb::LogEntries>& out)
     {
-      for (multimap<Time, const Event>::const_iterator i = events_.cbegin();
-           i != events_.cend();
-           ++i) {
-        roah_rsbb::ScheduleInfo msg;
-        msg.team = i->second.team;
-        msg.benchmark = i->second.benchmark.desc;
-        msg.round = i->second.round;
-        msg.run = i->second.run;
-        msg.time = to_string (i->second.scheduled_time);
-        msg.running = ( (i == current_event_) && executing_benchmark_);
-        map.insert (make_pair (i->second.scheduled_time, msg));
+      std::lock_guard<std::mutex> lock (snapshot_mutex_);
+      for (auto& i : new_log_) {
+        out.push_back (move (i));
       }
+      new_log_.clear();
+    }
+
+    /*
+     * Can be called from any thread. The newest entries of a stream of
+     * display text, as of the last snapshot, for clients that join while a
+     * benchmark is executing.
+     */
+    void
+    backlog (uint8_t stream,
+             roah_rsbb::LogEntries& entries)
+    {
+      std::lock_guard<std::mutex> lock (snapshot_mutex_);
+      BacklogText const& backlog = log_backlogs_[stream];
+      entries.zone = name_;
+      entries.stream = stream;
+      entries.epoch = backlog.epoch;
+      entries.first_seq = backlog.first_seq;
+      entries.entries.assign (backlog.entries.begin(), backlog.entries.end());
+    }
+
+    /*
+     * Can be called from any thread. The events stay valid while the
+     * returned pointer is held, even if the schedule is replaced.
+     */
+    shared_ptr<const ZoneEvents>
+    events() const
+    {
+      return std::atomic_load (&events_);
+    }
+
+    /*
+     * Can be called from any thread. The event being executed, as of the
+     * last snapshot, or nullptr.
+     */
+    Event const*
+    running_event() const
+    {
+      return running_event_.load();
     }
 };
 
@@ -424,30 +696,184 @@ class CoreZoneManager
 {
     CoreSharedState& ss_;
 
-    map<string, Zone::Ptr> zones_;
+  public:
+    typedef map<string, shared_ptr<const ZoneEvents>> Schedule;
+    typedef shared_ptr<const map<string, Zone::Ptr>> Zones;
+
+  private:
+    std::mutex apply_mutex_;
+    // Replaced by apply(), other threads use std::atomic_load
+    Zones zones_;
+    // Zones removed by a reload, destroyed by reap() once no reader holds
+    // them, so never in their own thread. Guarded by apply_mutex_
+    list<Zone::Ptr> retired_;
+    Timer reap_timer_;
+
+    void
+    reap (const TimerEvent& = TimerEvent())
+    {
+      std::lock_guard<std::mutex> lock (apply_mutex_);
+      retired_.remove_if ([] (Zone::Ptr const& zone) {
+        return zone.use_count() == 1;
+      });
+    }
 
   public:
-    CoreZoneManager (CoreSharedState& ss)
-      : ss_ (ss)
+
+    /*
+     * Throws config_error, or YAML::Exception if the file cannot be parsed.
+     */
+    static Schedule
+    parse_schedule (string const& file_name,
+                    Benchmarks const& benchmarks,
+                    Passwords const& passwords)
     {
       using namespace YAML;
 
-      Node file = LoadFile (param_direct<string> ("~schedule_file", "schedule.yaml"));
+      Schedule schedule;
+
+      Node file = LoadFile (file_name);
       if (! file.IsSequence()) {
-        ROS_FATAL_STREAM ("Schedule file is not a sequence!");
-        abort_rsbb();
+        THROW_CONFIG_ERROR ("Schedule file is not a sequence!");
       }
       for (Node const& zone_node : file) {
-        Zone::Ptr zone = make_shared<Zone> (ss_, zone_node);
-        zones_[zone->name()] = zone;
+        if (! zone_node["zone"]) {
+          THROW_CONFIG_ERROR ("Schedule file is missing a \"zone\" entry!");
+        }
+        string name = zone_node["zone"].as<string>();
+
+        if (! zone_node["schedule"]) {
+          THROW_CONFIG_ERROR ("Schedule file is missing a \"schedule\" entry!");
+        }
+        if (! zone_node["schedule"].IsSequence()) {
+          THROW_CONFIG_ERROR ("Schedule in schedule file is not a sequence!");
+        }
+        shared_ptr<ZoneEvents> events = make_shared<ZoneEvents>();
+        for (YAML::Node const& event_node : zone_node["schedule"]) {
+          Event e = Event (event_node);
+          e.benchmark = benchmarks.get (e.benchmark_code);
+          if (e.team != "ALL") {
+            e.password = passwords.get (e.team);
+          }
+          events->insert (make_pair (e.scheduled_time, e));
+
+          if (! ( (e.benchmark_code == "HGTKMH")
+                  || (e.benchmark_code == "HWV")
+                  || (e.benchmark_code == "HCFGAC")
+                  || (e.benchmark_code == "HOPF")
+                  || (e.benchmark_code == "HNF")
+                  || (e.benchmark_code == "HSUF")
+                  || (e.benchmark_code == "STB"))) {
+            THROW_CONFIG_ERROR ("Zone " << name << ": unsupported benchmark code " << e.benchmark_code);
+          }
+
+          if (e.benchmark_code == "HSUF") {
+            if (e.team != "ALL") {
+              THROW_CONFIG_ERROR ("Zone " << name << ": benchmark code HSUF only supported for team ALL");
+            }
+          }
+
+          if ( (e.benchmark_code == "HGTKMH")
+               || (e.benchmark_code == "HWV")
+               || (e.benchmark_code == "HCFGAC")
+               || (e.benchmark_code == "HOPF")
+               || (e.benchmark_code == "HNF")
+               || (e.benchmark_code == "STB")) {
+            if (e.team == "ALL") {
+              THROW_CONFIG_ERROR ("Zone " << name << ": benchmark code " << e.benchmark_code << " not supported for team ALL");
+            }
+          }
+        }
+
+        if (events->empty()) {
+          THROW_CONFIG_ERROR ("Zone " << name << " has no schedule defined");
+        }
+        schedule[name] = events;
+      }
+      return schedule;
+    }
+
+    CoreZoneManager (CoreSharedState& ss)
+      : ss_ (ss)
+    {
+      CoreConfig const& config = ss_.config.get();
+      Schedule schedule;
+      try {
+        schedule = parse_schedule (config.schedule_file, ss_.benchmarks.get(), ss_.passwords.get());
+      }
+      catch (std::exception const& e) {
+        ROS_FATAL_STREAM ("Error loading " << config.schedule_file << ": " << e.what());
+        abort_rsbb();
+      }
+      apply (schedule);
+      reap_timer_ = ss_.nh.createTimer (Duration (1.0), &CoreZoneManager::reap, this);
+    }
+
+    /*
+     * Creates the new zones and posts the new events to the existing ones,
+     * which apply them when they are not executing. Zones that are missing
+     * from the schedule are dropped, unless they are executing, and
+     * destroyed later by reap().
+     *
+     * The events are posted even if they look unchanged, as a zone may have
+     * a delayed update that they must replace.
+     */
+    void
+    apply (Schedule const& schedule)
+    {
+      std::lock_guard<std::mutex> lock (apply_mutex_);
+
+      Zones old_zones = std::atomic_load (&zones_);
+      shared_ptr<map<string, Zone::Ptr>> zones = make_shared<map<string, Zone::Ptr>>();
+      bool changed = ! old_zones;
+      for (auto const& i : schedule) {
+        Zone::Ptr zone;
+        if (old_zones) {
+          auto old = old_zones->find (i.first);
+          if (old != old_zones->end()) {
+            zone = old->second;
+          }
+        }
+        if (! zone) {
+          zone = make_shared<Zone> (ss_, i.first, i.second);
+          changed = true;
+          if (old_zones) {
+            ROS_INFO_STREAM ("Zone: " << i.first << " added");
+          }
+        }
+        else {
+          zone->post (boost::bind (&Zone::set_events, zone.get(), i.second));
+        }
+        (*zones) [i.first] = zone;
+      }
+      if (old_zones) {
+        for (auto const& i : *old_zones) {
+          if (zones->count (i.first)) {
+            continue;
+          }
+          if (! i.second->try_remove()) {
+            ROS_WARN_STREAM ("Zone: " << i.first << " is executing, it is kept until the next reload");
+            (*zones) [i.first] = i.second;
+            continue;
+          }
+          ROS_INFO_STREAM ("Zone: " << i.first << " removed");
+          retired_.push_back (i.second);
+          changed = true;
+        }
+      }
+
+      if (changed) {
+        std::atomic_store (&zones_, Zones (zones));
+        ++ss_.schedule_version;
       }
     }
 
     Zone::Ptr
     get (string const& name)
     {
-      auto zone = zones_.find (name);
-      if (zone != zones_.end()) {
+      Zones zones = this->zones();
+      auto zone = zones->find (name);
+      if (zone != zones->end()) {
         return zone->second;
       }
       return Zone::Ptr();
@@ -457,22 +883,22 @@ class CoreZoneManager
     msg (Time const& now,
          vector<roah_rsbb::ZoneState>& msg)
     {
-      for (auto const& i : zones_) {
+      Zones zones = this->zones();
+      for (auto const& i : *zones) {
         if (i.second) {
-          msg.push_back (i.second->msg (now));
+          msg.push_back (i.second->msg());
         }
       }
     }
 
-    void
-    msg (Time const& now,
-         multimap<Time, roah_rsbb::ScheduleInfo>& map)
+    /*
+     * Can be called from any thread. The map and its zones stay valid while
+     * the returned pointer is held, even after a reload.
+     */
+    Zones
+    zones() const
     {
-      for (auto const& i : zones_) {
-        if (i.second) {
-          i.second->msg (now, map);
-        }
-      }
+      return std::atomic_load (&zones_);
     }
 };
 
@@ -0,0 +1,312 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+
+
+using namespace std;
+
+
+
+/*
+ * Micro-benchmark of the encryption of the private channels. Each message
+ * is encrypted and decrypted again, as the core and a robot do for every
+ * BenchmarkState and RobotState. Reports messages per second per thread
+ * for:
+ *  - per-message: a new cipher context and key derivation for every
+ *    message;
+ *  - reused: contexts and key derived once, only the IV changes;
+ *  - gcm: reused contexts with AES-128-GCM, which also authenticates.
+ *
+ * These are standalone OpenSSL implementations of each setup. They do not
+ * use the channel code of the comm submodule, so per-message is only a
+ * model of it, and the numbers compare the setups, not the channels.
+ *
+ * Usage: rsbb_crypto_bench [payload_bytes] [seconds] [threads]
+ */
+
+
+
+typedef std::chrono::steady_clock clock_type;
+
+const string PASSWORD = "benchmark_password";
+const size_t IV_SIZE = 16;
+const size_t GCM_IV_SIZE = 12;
+const size_t GCM_TAG_SIZE = 16;
+
+
+
+void
+derive_key (EVP_CIPHER const* cipher,
+            unsigned char* key)
+{
+  EVP_BytesToKey (cipher, EVP_sha256(), nullptr,
+                  reinterpret_cast<unsigned char const*> (PASSWORD.data()), PASSWORD.size(),
+                  8, key, nullptr);
+}
+
+
+
+class Mode
+{
+  public:
+    virtual
+    ~Mode()
+    {
+    }
+
+    // Encrypts and decrypts plain, returns false if the round trip fails
+    virtual bool
+    round_trip (vector<unsigned char> const& plain) = 0;
+};
+
+
+
+class PerMessageCbc
+  : public Mode
+{
+    vector<unsigned char> enc_;
+    vector<unsigned char> dec_;
+
+  public:
+    bool
+    round_trip (vector<unsigned char> const& plain)
+    {
+      EVP_CIPHER const* cipher = EVP_aes_128_cbc();
+      unsigned char key[EVP_MAX_KEY_LENGTH];
+      unsigned char iv[IV_SIZE];
+      RAND_bytes (iv, IV_SIZE);
+      enc_.resize (plain.size() + EVP_MAX_BLOCK_LENGTH);
+      dec_.resize (enc_.size() + EVP_MAX_BLOCK_LENGTH);
+      int len, final_len;
+
+      derive_key (cipher, key);
+      EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+      EVP_EncryptInit_ex (ctx, cipher, nullptr, key, iv);
+      EVP_EncryptUpdate (ctx, enc_.data(), &len, plain.data(), plain.size());
+      EVP_EncryptFinal_ex (ctx, enc_.data() + len, &final_len);
+      EVP_CIPHER_CTX_free (ctx);
+      int enc_len = len + final_len;
+
+      derive_key (cipher, key);
+      ctx = EVP_CIPHER_CTX_new();
+      EVP_DecryptInit_ex (ctx, cipher, nullptr, key, iv);
+      EVP_DecryptUpdate (ctx, dec_.data(), &len, enc_.data(), enc_len);
+      bool ok = EVP_DecryptFinal_ex (ctx, dec_.data() + len, &final_len) == 1;
+      EVP_CIPHER_CTX_free (ctx);
+      return ok && (static_cast<size_t> (len + final_len) == plain.size());
+    }
+};
+
+
+
+class ReusedCbc
+  : public Mode
+{
+    EVP_CIPHER_CTX* enc_ctx_;
+    EVP_CIPHER_CTX* dec_ctx_;
+    vector<unsigned char> enc_;
+    vector<unsigned char> dec_;
+
+  public:
+    ReusedCbc()
+      : enc_ctx_ (EVP_CIPHER_CTX_new())
+      , dec_ctx_ (EVP_CIPHER_CTX_new())
+    {
+      unsigned char key[EVP_MAX_KEY_LENGTH];
+      derive_key (EVP_aes_128_cbc(), key);
+      EVP_EncryptInit_ex (enc_ctx_, EVP_aes_128_cbc(), nullptr, key, nullptr);
+      EVP_DecryptInit_ex (dec_ctx_, EVP_aes_128_cbc(), nullptr, key, nullptr);
+    }
+
+    ~ReusedCbc()
+    {
+      EVP_CIPHER_CTX_free (enc_ctx_);
+      EVP_CIPHER_CTX_free (dec_ctx_);
+    }
+
+    bool
+    round_trip (vector<unsigned char> const& plain)
+    {
+      unsigned char iv[IV_SIZE];
+      RAND_bytes (iv, IV_SIZE);
+      enc_.resize (plain.size() + EVP_MAX_BLOCK_LENGTH);
+      dec_.resize (enc_.size() + EVP_MAX_BLOCK_LENGTH);
+      int len, final_len;
+
+      EVP_EncryptInit_ex (enc_ctx_, nullptr, nullptr, nullptr, iv);
+      EVP_EncryptUpdate (enc_ctx_, enc_.data(), &len, plain.data(), plain.size());
+      EVP_EncryptFinal_ex (enc_ctx_, enc_.data() + len, &final_len);
+      int enc_len = len + final_len;
+
+      EVP_DecryptInit_ex (dec_ctx_, nullptr, nullptr, nullptr, iv);
+      EVP_DecryptUpdate (dec_ctx_, dec_.data(), &len, enc_.data(), enc_len);
+      bool ok = EVP_DecryptFinal_ex (dec_ctx_, dec_.data() + len, &final_len) == 1;
+      return ok && (static_cast<size_t> (len + final_len) == plain.size());
+    }
+};
+
+
+
+class ReusedGcm
+  : public Mode
+{
+    EVP_CIPHER_CTX* enc_ctx_;
+    EVP_CIPHER_CTX* dec_ctx_;
+    vector<unsigned char> enc_;
+    vector<unsigned char> dec_;
+
+  public:
+    ReusedGcm()
+      : enc_ctx_ (EVP_CIPHER_CTX_new())
+      , dec_ctx_ (EVP_CIPHER_CTX_new())
+    {
+      unsigned char key[EVP_MAX_KEY_LENGTH];
+      derive_key (EVP_aes_128_gcm(), key);
+      EVP_EncryptInit_ex (enc_ctx_, EVP_aes_128_gcm(), nullptr, key, nullptr);
+      EVP_DecryptInit_ex (dec_ctx_, EVP_aes_128_gcm(), nullptr, key, nullptr);
+    }
+
+    ~ReusedGcm()
+    {
+      EVP_CIPHER_CTX_free (enc_ctx_);
+      EVP_CIPHER_CTX_free (dec_ctx_);
+    }
+
+    bool
+    round_trip (vector<unsigned char> const& plain)
+    {
+      unsigned char iv[GCM_IV_SIZE];
+      unsigned char tag[GCM_TAG_SIZE];
+      RAND_bytes (iv, GCM_IV_SIZE);
+      enc_.resize (plain.size());
+      dec_.resize (plain.size());
+      int len, final_len;
+
+      EVP_EncryptInit_ex (enc_ctx_, nullptr, nullptr, nullptr, iv);
+      EVP_EncryptUpdate (enc_ctx_, enc_.data(), &len, plain.data(), plain.size());
+      EVP_EncryptFinal_ex (enc_ctx_, enc_.data() + len, &final_len);
+      EVP_CIPHER_CTX_ctrl (enc_ctx_, EVP_CTRL_GCM_GET_TAG, GCM_TAG_SIZE, tag);
+      int enc_len = len + final_len;
+
+      EVP_DecryptInit_ex (dec_ctx_, nullptr, nullptr, nullptr, iv);
+      EVP_DecryptUpdate (dec_ctx_, dec_.data(), &len, enc_.data(), enc_len);
+      EVP_CIPHER_CTX_ctrl (dec_ctx_, EVP_CTRL_GCM_SET_TAG, GCM_TAG_SIZE, tag);
+      bool ok = EVP_DecryptFinal_ex (dec_ctx_, dec_.data() + len, &final_len) == 1;
+      return ok && (static_cast<size_t> (len + final_len) == plain.size());
+    }
+};
+
+
+
+Mode*
+make_mode (string const& name)
+{
+  if (name == "per-message") {
+    return new PerMessageCbc();
+  }
+  if (name == "reused") {
+    return new ReusedCbc();
+  }
+  return new ReusedGcm();
+}
+
+
+
+void
+run (string const& name,
+     size_t payload,
+     double seconds,
+     unsigned threads)
+{
+  vector<unsigned long> counts (threads, 0);
+  // Not vector<bool>, whose packed flags cannot be written concurrently
+  vector<char> ok (threads, true);
+  vector<std::thread> workers;
+
+  clock_type::time_point end = clock_type::now() + std::chrono::duration_cast<clock_type::duration> (std::chrono::duration<double> (seconds));
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back ([&, t] () {
+      unique_ptr<Mode> mode (make_mode (name));
+      vector<unsigned char> plain (payload);
+      RAND_bytes (plain.data(), plain.size());
+      unsigned long count = 0;
+      bool round_trips_ok = true;
+      // Checking the clock every message would cost as much as the small ones
+      while (clock_type::now() < end) {
+        for (unsigned i = 0; i < 256; ++i) {
+          if (! mode->round_trip (plain)) {
+            round_trips_ok = false;
+          }
+        }
+        count += 256;
+      }
+      counts[t] = count;
+      ok[t] = round_trips_ok;
+    });
+  }
+
+  unsigned long total = 0;
+  bool all_ok = true;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers[t].join();
+    total += counts[t];
+    all_ok = all_ok && ok[t];
+  }
+
+  double rate = total / seconds;
+  cout << setw (12) << name
+       << setw (14) << fixed << setprecision (0) << (rate / threads) << " msg/s/thread"
+       << setw (14) << rate << " msg/s"
+       << (all_ok ? "" : "  ROUND TRIP FAILED") << endl;
+}
+
+
+
+int
+main (int argc,
+      char* argv[])
+{
+  size_t payload = (argc > 1) ? strtoul (argv[1], nullptr, 10) : 128;
+  double seconds = (argc > 2) ? strtod (argv[2], nullptr) : 2.0;
+  unsigned threads = (argc > 3) ? strtoul (argv[3], nullptr, 10) : 1;
+  if ( (payload == 0) || (seconds <= 0) || (threads == 0)) {
+    cerr << "Usage: " << argv[0] << " [payload_bytes] [seconds] [threads]" << endl;
+    return 1;
+  }
+
+  cout << "Encrypt and decrypt round trips of " << payload << " bytes, "
+       << threads << " thread(s), " << seconds << " s each" << endl;
+  run ("per-message", payload, seconds, threads);
+  run ("reused", payload, seconds, threads);
+  run ("gcm", payload, seconds, threads);
+
+  return 0;
+}
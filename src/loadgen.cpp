@@ -0,0 +1,487 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <ros/ros.h>
+
+#include <ros_roah_rsbb.h>
+
+
+
+using namespace std;
+using namespace ros;
+
+
+
+/*
+ * Synthetic load for the core: simulates robots and tablets that send
+ * beacons on the public channel, and robots that join their private
+ * channel when the core benchmarks them, as a real robot does. Everything
+ * received from the channels is handled in the ROS callback queue, so
+ * that the simulation is single threaded.
+ */
+
+
+
+class LatencyStats
+  : boost::noncopyable
+{
+    string name_;
+    vector<double> window_;
+    size_t total_count_;
+    double total_sum_;
+    double total_max_;
+
+    static double
+    percentile (vector<double>& samples,
+                double p)
+    {
+      size_t n = static_cast<size_t> (p * (samples.size() - 1));
+      nth_element (samples.begin(), samples.begin() + n, samples.end());
+      return samples[n];
+    }
+
+  public:
+    LatencyStats (string const& name)
+      : name_ (name)
+      , total_count_ (0)
+      , total_sum_ (0)
+      , total_max_ (0)
+    {
+    }
+
+    void
+    add (Duration const& latency)
+    {
+      double ms = latency.toSec() * 1000;
+      window_.push_back (ms);
+      ++total_count_;
+      total_sum_ += ms;
+      total_max_ = max (total_max_, ms);
+    }
+
+    // Logs the samples since the last report and starts a new window
+    void
+    report()
+    {
+      if (window_.empty()) {
+        ROS_INFO_STREAM (name_ << ": no samples");
+        return;
+      }
+
+      double sum = 0;
+      for (double s : window_) {
+        sum += s;
+      }
+      double mean = sum / window_.size();
+      double p50 = percentile (window_, 0.5);
+      double p99 = percentile (window_, 0.99);
+      double max_ms = *max_element (window_.begin(), window_.end());
+
+      ROS_INFO_STREAM (name_ << ": " << window_.size() << " samples"
+                       << ", mean " << mean << " ms"
+                       << ", p50 " << p50 << " ms"
+                       << ", p99 " << p99 << " ms"
+                       << ", max " << max_ms << " ms");
+      window_.clear();
+    }
+
+    void
+    report_total()
+    {
+      if (total_count_ == 0) {
+        ROS_INFO_STREAM (name_ << " total: no samples");
+        return;
+      }
+
+      ROS_INFO_STREAM (name_ << " total: " << total_count_ << " samples"
+                       << ", mean " << (total_sum_ / total_count_) << " ms"
+                       << ", max " << total_max_ << " ms");
+    }
+};
+
+
+
+/*
+ * Follows the script of a well-behaved robot:
+ *  - STOP: STOP
+ *  - PREPARE: PREPARING for ~prepare_time, then WAITING_GOAL
+ *  - GOAL_TX: EXECUTING
+ *  - WAITING_RESULT: EXECUTING for ~execute_time, then RESULT_TX
+ *
+ * The ack round-trip latency goes from sending a RobotState to receiving
+ * the first BenchmarkState that acknowledges it. The transition latency
+ * goes from changing the robot state to receiving the next benchmark
+ * state change.
+ */
+class SimRobot
+  : boost::noncopyable
+{
+    NodeHandle& nh_;
+    const string team_;
+    const string robot_;
+    const string password_;
+    const string host_;
+    const string cypher_;
+    const Duration state_period_;
+    const Duration prepare_time_;
+    const Duration execute_time_;
+    LatencyStats& ack_rtt_;
+    LatencyStats& transition_latency_;
+
+    unique_ptr<roah_rsbb::RosPrivateChannel> private_channel_;
+    unsigned short port_;
+    Timer state_timer_;
+    Timer script_timer_;
+
+    roah_rsbb_msgs::BenchmarkState::State benchmark_state_;
+    roah_rsbb_msgs::RobotState::State robot_state_;
+    uint32_t messages_saved_;
+    Time last_ack_;
+    Time state_change_time_;
+    bool transition_pending_;
+
+    void
+    transmit (const TimerEvent& = TimerEvent())
+    {
+      if (! private_channel_) {
+        return;
+      }
+
+      Time now = Time::now();
+
+      roah_rsbb_msgs::RobotState msg;
+      msg.mutable_time()->set_sec (now.sec);
+      msg.mutable_time()->set_nsec (now.nsec);
+      msg.set_messages_saved (++messages_saved_);
+      msg.set_robot_state (robot_state_);
+      private_channel_->send (msg);
+    }
+
+    void
+    set_robot_state (roah_rsbb_msgs::RobotState::State state,
+                     bool expect_transition)
+    {
+      robot_state_ = state;
+      transition_pending_ = expect_transition;
+      state_change_time_ = Time::now();
+      script_timer_.stop();
+      transmit();
+    }
+
+    void
+    script (roah_rsbb_msgs::RobotState::State state,
+            Duration const& delay)
+    {
+      script_timer_ = nh_.createTimer (delay, boost::bind (&SimRobot::set_robot_state, this, state, true), true);
+    }
+
+    void
+    handle_benchmark_state (unsigned short port,
+                            Time const& rcv_time,
+                            std::shared_ptr<const roah_rsbb_msgs::BenchmarkState> msg)
+    {
+      if ( (! private_channel_) || (port != port_)) {
+        // From a channel already closed
+        return;
+      }
+
+      Time ack (msg->acknowledgement().sec(), msg->acknowledgement().nsec());
+      if (ack > last_ack_) {
+        ack_rtt_.add (rcv_time - ack);
+        last_ack_ = ack;
+      }
+
+      if (msg->benchmark_state() == benchmark_state_) {
+        return;
+      }
+      benchmark_state_ = msg->benchmark_state();
+
+      if (transition_pending_) {
+        transition_latency_.add (rcv_time - state_change_time_);
+        transition_pending_ = false;
+      }
+
+      switch (benchmark_state_) {
+        case roah_rsbb_msgs::BenchmarkState_State_STOP:
+          set_robot_state (roah_rsbb_msgs::RobotState_State_STOP, false);
+          break;
+        case roah_rsbb_msgs::BenchmarkState_State_PREPARE:
+          set_robot_state (roah_rsbb_msgs::RobotState_State_PREPARING, false);
+          script (roah_rsbb_msgs::RobotState_State_WAITING_GOAL, prepare_time_);
+          break;
+        case roah_rsbb_msgs::BenchmarkState_State_GOAL_TX:
+          set_robot_state (roah_rsbb_msgs::RobotState_State_EXECUTING, true);
+          break;
+        case roah_rsbb_msgs::BenchmarkState_State_WAITING_RESULT:
+          set_robot_state (roah_rsbb_msgs::RobotState_State_EXECUTING, false);
+          script (roah_rsbb_msgs::RobotState_State_RESULT_TX, execute_time_);
+          break;
+      }
+    }
+
+    // Runs in the thread of the channel
+    void
+    receive_benchmark_state (unsigned short port,
+                             boost::asio::ip::udp::endpoint& endpoint,
+                             uint16_t comp_id,
+                             uint16_t msg_type,
+                             std::shared_ptr<const roah_rsbb_msgs::BenchmarkState> msg)
+    {
+      Time rcv_time = Time::now();
+      boost::function<void()> f = boost::bind (&SimRobot::handle_benchmark_state, this, port, rcv_time, msg);
+      getGlobalCallbackQueue()->addCallback (boost::make_shared<roah_rsbb::CallbackItem> (f));
+    }
+
+    void
+    open (unsigned short port)
+    {
+      if (private_channel_ && (port == port_)) {
+        return;
+      }
+
+      ROS_INFO_STREAM (team_ << "/" << robot_ << ": joining private channel on port " << port);
+      close();
+      port_ = port;
+      private_channel_.reset (new roah_rsbb::RosPrivateChannel (host_, port, password_, cypher_));
+      private_channel_->signal_benchmark_state_received().connect (boost::bind (&SimRobot::receive_benchmark_state, this, port, _1, _2, _3, _4));
+      state_timer_ = nh_.createTimer (state_period_, &SimRobot::transmit, this);
+    }
+
+    void
+    close()
+    {
+      if (! private_channel_) {
+        return;
+      }
+
+      ROS_INFO_STREAM (team_ << "/" << robot_ << ": leaving private channel on port " << port_);
+      state_timer_.stop();
+      script_timer_.stop();
+      private_channel_.reset();
+      benchmark_state_ = roah_rsbb_msgs::BenchmarkState_State_STOP;
+      robot_state_ = roah_rsbb_msgs::RobotState_State_STOP;
+      transition_pending_ = false;
+    }
+
+  public:
+    SimRobot (NodeHandle& nh,
+              string const& team,
+              string const& robot,
+              string const& password,
+              LatencyStats& ack_rtt,
+              LatencyStats& transition_latency)
+      : nh_ (nh)
+      , team_ (team)
+      , robot_ (robot)
+      , password_ (password)
+      , host_ (param_direct<string> ("~rsbb_host", "127.255.255.255"))
+      , cypher_ (param_direct<string> ("~rsbb_cypher", "aes-128-cbc"))
+      , state_period_ (1.0 / param_direct<double> ("~state_rate", 5.0))
+      , prepare_time_ (param_direct<double> ("~prepare_time", 1.0))
+      , execute_time_ (param_direct<double> ("~execute_time", 3.0))
+      , ack_rtt_ (ack_rtt)
+      , transition_latency_ (transition_latency)
+      , port_ (0)
+      , benchmark_state_ (roah_rsbb_msgs::BenchmarkState_State_STOP)
+      , robot_state_ (roah_rsbb_msgs::RobotState_State_STOP)
+      , messages_saved_ (0)
+      , last_ack_ (0)
+      , transition_pending_ (false)
+    {
+    }
+
+    void
+    fill_beacon (roah_rsbb_msgs::RobotBeacon& msg,
+                 Time const& now) const
+    {
+      msg.set_team_name (team_);
+      msg.set_robot_name (robot_);
+      msg.mutable_time()->set_sec (now.sec);
+      msg.mutable_time()->set_nsec (now.nsec);
+    }
+
+    void
+    rsbb_beacon (roah_rsbb_msgs::RoahRsbbBeacon const& msg)
+    {
+      for (auto const& bt : msg.benchmarking_teams()) {
+        if ( (bt.team_name() == team_) && (bt.robot_name() == robot_)) {
+          open (bt.rsbb_port());
+          return;
+        }
+      }
+      close();
+    }
+};
+
+
+
+class LoadGen
+  : boost::noncopyable
+  , public roah_rsbb::RosPublicChannel
+{
+    NodeHandle nh_;
+
+    LatencyStats ack_rtt_;
+    LatencyStats transition_latency_;
+    LatencyStats beacon_interval_;
+
+    vector<unique_ptr<SimRobot>> robots_;
+    size_t tablets_;
+    Time last_rsbb_beacon_;
+
+    Timer beacon_timer_;
+    Timer report_timer_;
+
+    void
+    transmit_beacons (const TimerEvent& = TimerEvent())
+    {
+      Time now = Time::now();
+
+      for (auto const& robot : robots_) {
+        roah_rsbb_msgs::RobotBeacon msg;
+        robot->fill_beacon (msg, now);
+        send (msg);
+      }
+
+      for (size_t i = 0; i < tablets_; ++i) {
+        roah_rsbb_msgs::TabletBeacon msg;
+        msg.mutable_last_call()->set_sec (0);
+        msg.mutable_last_call()->set_nsec (0);
+        msg.mutable_last_pos()->set_sec (0);
+        msg.mutable_last_pos()->set_nsec (0);
+        msg.set_x (0);
+        msg.set_y (0);
+        send (msg);
+      }
+    }
+
+    void
+    handle_rsbb_beacon (Time const& rcv_time,
+                        std::shared_ptr<const roah_rsbb_msgs::RoahRsbbBeacon> msg)
+    {
+      if (! last_rsbb_beacon_.isZero()) {
+        beacon_interval_.add (rcv_time - last_rsbb_beacon_);
+      }
+      last_rsbb_beacon_ = rcv_time;
+
+      for (auto const& robot : robots_) {
+        robot->rsbb_beacon (*msg);
+      }
+    }
+
+    // Runs in the thread of the channel
+    void
+    receive_rsbb_beacon (boost::asio::ip::udp::endpoint endpoint,
+                         uint16_t comp_id,
+                         uint16_t msg_type,
+                         std::shared_ptr<const roah_rsbb_msgs::RoahRsbbBeacon> msg)
+    {
+      Time rcv_time = Time::now();
+      boost::function<void()> f = boost::bind (&LoadGen::handle_rsbb_beacon, this, rcv_time, msg);
+      getGlobalCallbackQueue()->addCallback (boost::make_shared<roah_rsbb::CallbackItem> (f));
+    }
+
+    void
+    report (const TimerEvent& = TimerEvent())
+    {
+      ack_rtt_.report();
+      transition_latency_.report();
+      beacon_interval_.report();
+    }
+
+  public:
+    LoadGen()
+      : roah_rsbb::RosPublicChannel (param_direct<string> ("~rsbb_host", "127.255.255.255"),
+                                     param_direct<int> ("~rsbb_port", 6666))
+      , ack_rtt_ ("Ack round-trip")
+      , transition_latency_ ("State transition")
+      , beacon_interval_ ("RSBB beacon interval")
+      , tablets_ (param_direct<int> ("~tablets", 1))
+      , last_rsbb_beacon_ (0)
+    {
+      using namespace YAML;
+
+      Node file = LoadFile (param_direct<string> ("~passwords_file", "passwords.yaml"));
+      if (! file.IsMap()) {
+        ROS_FATAL_STREAM ("Passwords file is not a map!");
+        shutdown();
+        return;
+      }
+      vector<pair<string, string>> teams;
+      for (auto const& team_node : file) {
+        teams.push_back (make_pair (team_node.first.as<string>(), team_node.second.as<string>()));
+      }
+      if (teams.empty()) {
+        ROS_FATAL_STREAM ("Passwords file has no teams!");
+        shutdown();
+        return;
+      }
+
+      // Robots are spread over the teams, the core benchmarks one per team
+      int robots = param_direct<int> ("~robots", teams.size());
+      for (int i = 0; i < robots; ++i) {
+        auto const& team = teams[i % teams.size()];
+        robots_.emplace_back (new SimRobot (nh_, team.first, "loadgen_" + to_string (i), team.second, ack_rtt_, transition_latency_));
+      }
+
+      set_rsbb_beacon_callback (&LoadGen::receive_rsbb_beacon, this);
+
+      beacon_timer_ = nh_.createTimer (Duration (1.0 / param_direct<double> ("~beacon_rate", 1.0)), &LoadGen::transmit_beacons, this);
+      report_timer_ = nh_.createTimer (Duration (param_direct<double> ("~report_period", 5.0)), &LoadGen::report, this);
+
+      ROS_INFO_STREAM ("Simulating " << robots_.size() << " robots of " << teams.size()
+                       << " teams and " << tablets_ << " tablets");
+    }
+
+    ~LoadGen()
+    {
+      beacon_timer_.stop();
+      report_timer_.stop();
+      signal_rsbb_beacon_received().disconnect_all_slots();
+
+      ack_rtt_.report_total();
+      transition_latency_.report_total();
+      beacon_interval_.report_total();
+    }
+};
+
+
+
+int
+main (int argc,
+      char* argv[])
+{
+  init (argc, argv, "roah_rsbb_loadgen");
+
+  LoadGen loadgen;
+
+  spin();
+
+  return 0;
+}
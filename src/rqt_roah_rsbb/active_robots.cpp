@@ -36,6 +36,7 @@ namespace rqt_roah_rsbb
   ActiveRobots::ActiveRobots()
     : rqt_gui_cpp::Plugin()
     , widget_ (0)
+    , model_ (0)
   {
     setObjectName ("ActiveRobots");
   }
@@ -49,56 +50,71 @@ namespace rqt_roah_rsbb
     // extend the widget with all attributes and children from UI file
     ui_.setupUi (widget_);
 
+    model_ = new TableModel (QStringList() << "Team" << "Robot" << "Clock Skew" << "Last Beacon", widget_);
+    ui_.table->setModel (model_);
     ui_.table->horizontalHeader()->setResizeMode (QHeaderView::Stretch);
 
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
+    cache_ = CoreCache::acquire (getNodeHandle());
+    connect (cache_.get(), SIGNAL (core_changed (unsigned)), this, SLOT (update (unsigned)));
+    refresh();
 
-    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
-    update_timer_.start (100);
+    // Only the beacon age changes without a new message
+    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (refresh()));
+    update_timer_.start (500);
   }
 
   void ActiveRobots::shutdownPlugin()
   {
     update_timer_.stop();
-    core_rcv_.stop();
+    cache_->disconnect (this);
+    cache_.reset();
   }
 
-  void ActiveRobots::update()
+  void ActiveRobots::update (unsigned flags)
+  {
+    if (flags & CoreCache::CORE_ROBOTS) {
+      refresh();
+    }
+  }
+
+  void ActiveRobots::refresh()
   {
     Time now = Time::now();
 
-    auto core_status = core_rcv_.last ();
+    auto core_status = cache_->last();
 
     if (! core_status) {
-      ui_.table->setRowCount (0);
+      model_->set (vector<TableRow>());
       return;
     }
 
-    ui_.table->setRowCount (core_status->active_robots.size());
-
+    // Rows whose text did not change are not signalled to the view
+    vector<TableRow> rows (core_status->active_robots.size());
     for (size_t r = 0; r < core_status->active_robots.size(); ++r) {
-      ui_.table->setItem (r, 0, new QTableWidgetItem (QString::fromStdString (core_status->active_robots.at (r).team)));
-      ui_.table->setItem (r, 1, new QTableWidgetItem (QString::fromStdString (core_status->active_robots.at (r).robot)));
+      roah_rsbb::RobotInfo const& robot = core_status->active_robots.at (r);
+      rows[r].cells << QString::fromStdString (robot.team)
+                    << QString::fromStdString (robot.robot);
 
-      auto skew = core_status->active_robots.at (r).skew.toSec();
+      auto skew = robot.skew.toSec();
       if ( (-0.1 < skew) && (skew < 0.1)) {
-        ui_.table->setItem (r, 2, new QTableWidgetItem ("OK"));
+        rows[r].cells << "OK";
       }
       else {
-        ui_.table->setItem (r, 2, new QTableWidgetItem (QString::number (skew, 'f', 1)));
+        rows[r].cells << QString::number (skew, 'f', 1);
       }
 
-      auto beacon = (core_status->active_robots.at (r).beacon - now).toSec();
+      auto beacon = (robot.beacon - now).toSec();
       if ( (-3 < beacon) && (beacon < 0)) {
-        ui_.table->setItem (r, 3, new QTableWidgetItem ("OK"));
+        rows[r].cells << "OK";
       }
       else {
-        ui_.table->setItem (r, 3, new QTableWidgetItem (QString::number (beacon, 'f', 1)));
+        rows[r].cells << QString::number (beacon, 'f', 1);
       }
     }
+    model_->set (rows);
   }
 }
 
@@ -26,8 +26,9 @@
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_active_robots.h>
-#include <roah_rsbb/CoreToGui.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/CoreState.h>
+#include "core_cache.h"
+#include "table_model.h"
 
 
 
@@ -47,10 +48,12 @@ namespace rqt_roah_rsbb
       Ui::ActiveRobots ui_;
       QWidget* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      TableModel* model_;
+      std::shared_ptr<CoreCache> cache_;
 
     private slots:
-      void update();
+      void update (unsigned flags);
+      void refresh();
   };
 }
 
@@ -67,81 +67,99 @@ namespace rqt_roah_rsbb
     connect (ui_.stop, SIGNAL (clicked()), this, SLOT (stop()));
     connect (ui_.previous, SIGNAL (clicked()), this, SLOT (previous()));
     connect (ui_.next, SIGNAL (clicked()), this, SLOT (next()));
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
 
-    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
+    cache_ = CoreCache::acquire (getNodeHandle());
+    connect (cache_.get(), SIGNAL (core_changed (unsigned)), this, SLOT (update_zones (unsigned)));
+    connect (cache_.get(), SIGNAL (current_zone_changed (unsigned)), this, SLOT (update (unsigned)));
+    update_zones (CoreCache::CORE_ZONES);
+    update (CoreCache::ZONE_ALL);
+
+    // Only the clock and a running timer change without a new message
+    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (tick()));
     update_timer_.start (200);
   }
 
   void BenchmarkControl::shutdownPlugin()
   {
     update_timer_.stop();
-    core_rcv_.stop();
+    cache_->disconnect (this);
+    cache_.reset();
   }
 
-  void BenchmarkControl::update()
+  void BenchmarkControl::select_current_zone()
   {
-    Time now = Time::now();
-
-    Time core_status_time;
-    auto core_status = core_rcv_.last (core_status_time);
+    int index = ui_.zone->findText (QString::fromStdString (cache_->current_zone_name()));
+    if ( (index >= 0) && (index != ui_.zone->currentIndex())) {
+      ui_.zone->blockSignals (true);
+      ui_.zone->setCurrentIndex (index);
+      ui_.zone->blockSignals (false);
+    }
+  }
 
-    if (! core_status) {
+  void BenchmarkControl::update_zones (unsigned flags)
+  {
+    if (! (flags & CoreCache::CORE_ZONES)) {
       return;
     }
 
-    ui_.clock->setText (to_qstring (Time (core_status->clock.sec, 0)));
-
-    param_direct ("current_zone", string(), current_zone_);
-
-    roah_rsbb::ZoneState const* current_zone = nullptr;
-
-    set<string> new_zones;
-    for (roah_rsbb::ZoneState const& zone : core_status->zones) {
-      new_zones.insert (zone.zone);
-      if (zone.zone == current_zone_) {
-        current_zone = &zone;
+    QStringList zones;
+    if (auto core = cache_->last()) {
+      for (roah_rsbb::ZoneTopic const& zone : core->zones) {
+        zones << QString::fromStdString (zone.zone);
       }
     }
+    zones.sort();
 
-    if (known_zones_ != new_zones) {
-      ui_.zone->clear();
-      for (string const& zone : new_zones) {
-        ui_.zone->addItem (QString::fromStdString (zone));
-      }
-      known_zones_ = move (new_zones);
+    ui_.zone->blockSignals (true);
+    ui_.zone->clear();
+    ui_.zone->addItems (zones);
+    ui_.zone->blockSignals (false);
+
+    if ( (! zones.contains (QString::fromStdString (cache_->current_zone_name()))) && (! zones.isEmpty())) {
+      zone (zones.first());
+    }
+    else {
+      select_current_zone();
     }
+  }
+
+  void BenchmarkControl::update (unsigned flags)
+  {
+    roah_rsbb::ZoneState const* current_zone = cache_->current_zone();
 
     if (current_zone) {
-      QString current_index_text = ui_.zone->itemText (ui_.zone->currentIndex());
-      QString new_zone = QString::fromStdString (current_zone_);
-      if (current_index_text != new_zone) {
-        ui_.zone->setCurrentIndex (ui_.zone->findText (new_zone)); // Guaranteed to exist by for loop above
+      select_current_zone();
+
+      if (flags & CoreCache::ZONE_INFO) {
+        ui_.name->setText (QString::fromStdString (current_zone->name));
+        ui_.desc->setText (QString::fromStdString (current_zone->desc));
+        ui_.code->setText (QString::fromStdString (current_zone->code));
+        ui_.timeout->setText (to_qstring (current_zone->timeout));
+        ui_.team->setText (QString::fromStdString (current_zone->team));
+        ui_.round->setText (QString::number (current_zone->round));
+        ui_.run->setText (QString::number (current_zone->run));
+        ui_.sched->setText (to_qstring (current_zone->schedule));
       }
 
-      ui_.name->setText (QString::fromStdString (current_zone->name));
-      ui_.desc->setText (QString::fromStdString (current_zone->desc));
-      ui_.code->setText (QString::fromStdString (current_zone->code));
-      ui_.timeout->setText (to_qstring (current_zone->timeout));
-      ui_.team->setText (QString::fromStdString (current_zone->team));
-      ui_.round->setText (QString::number (current_zone->round));
-      ui_.run->setText (QString::number (current_zone->run));
-      ui_.sched->setText (to_qstring (current_zone->schedule));
-
-      ui_.timer->setText (to_qstring (current_zone->timer));
-      QString new_state = QString::fromStdString (current_zone->state);
-      if (ui_.state->toPlainText() != new_state) {
-        ui_.state->setPlainText (new_state);
-        QScrollBar* sb = ui_.state->verticalScrollBar();
-        sb->setValue (sb->maximum());
+      if (flags & CoreCache::ZONE_TIMER) {
+        tick();
       }
 
-      ui_.connect->setEnabled (current_zone->connect_enabled);
-      ui_.disconnect->setEnabled (current_zone->disconnect_enabled);
-      ui_.start->setEnabled (current_zone->start_enabled);
-      ui_.stop->setEnabled (current_zone->stop_enabled);
-      ui_.previous->setEnabled (current_zone->prev_enabled);
-      ui_.next->setEnabled (current_zone->next_enabled);
+      if (flags & CoreCache::ZONE_STATE) {
+        QString new_state = QString::fromStdString (current_zone->state);
+        if (ui_.state->toPlainText() != new_state) {
+          ui_.state->setPlainText (new_state);
+          QScrollBar* sb = ui_.state->verticalScrollBar();
+          sb->setValue (sb->maximum());
+        }
+
+        ui_.connect->setEnabled (current_zone->connect_enabled);
+        ui_.disconnect->setEnabled (current_zone->disconnect_enabled);
+        ui_.start->setEnabled (current_zone->start_enabled);
+        ui_.stop->setEnabled (current_zone->stop_enabled);
+        ui_.previous->setEnabled (current_zone->prev_enabled);
+        ui_.next->setEnabled (current_zone->next_enabled);
+      }
     }
     else {
       ui_.name->setText ("--");
@@ -165,51 +183,73 @@ namespace rqt_roah_rsbb
     }
   }
 
+  void BenchmarkControl::tick()
+  {
+    if (! cache_->last()) {
+      return;
+    }
+
+    Time core_now = cache_->core_now();
+    ui_.clock->setText (to_qstring (Time (core_now.sec, 0)));
+
+    roah_rsbb::ZoneState const* current_zone = cache_->current_zone();
+    if (! current_zone) {
+      return;
+    }
+
+    if (current_zone->timer_paused) {
+      ui_.timer->setText (to_qstring (current_zone->timer));
+    }
+    else {
+      ui_.timer->setText (to_qstring (current_zone->timer_deadline - core_now));
+    }
+  }
+
   void BenchmarkControl::zone (QString const& zone)
   {
     NODELET_DEBUG_STREAM ("Setting zone to: " << zone.toStdString());
-    ros::param::set ("current_zone", zone.toStdString());
+    cache_->set_current_zone (zone.toStdString());
   }
 
   void BenchmarkControl::connect_s()
   {
     roah_rsbb::Zone z;
-    z.request.zone = current_zone_;
+    z.request.zone = cache_->current_zone_name();
     call_service ("/core/connect", z);
   }
 
   void BenchmarkControl::disconnect()
   {
     roah_rsbb::Zone z;
-    z.request.zone = current_zone_;
+    z.request.zone = cache_->current_zone_name();
     call_service ("/core/disconnect", z);
   }
 
   void BenchmarkControl::start()
   {
     roah_rsbb::Zone z;
-    z.request.zone = current_zone_;
+    z.request.zone = cache_->current_zone_name();
     call_service ("/core/start", z);
   }
 
   void BenchmarkControl::stop()
   {
     roah_rsbb::Zone z;
-    z.request.zone = current_zone_;
+    z.request.zone = cache_->current_zone_name();
     call_service ("/core/stop", z);
   }
 
   void BenchmarkControl::previous()
   {
     roah_rsbb::Zone z;
-    z.request.zone = current_zone_;
+    z.request.zone = cache_->current_zone_name();
     call_service ("/core/previous", z);
   }
 
   void BenchmarkControl::next()
   {
     roah_rsbb::Zone z;
-    z.request.zone = current_zone_;
+    z.request.zone = cache_->current_zone_name();
     call_service ("/core/next", z);
   }
 }
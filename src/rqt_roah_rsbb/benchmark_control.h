@@ -20,16 +20,14 @@
 #ifndef __RQT_ROAH_RSBB_BENCHMARK_CONTROL_H__
 #define __RQT_ROAH_RSBB_BENCHMARK_CONTROL_H__
 
-#include <set>
-
 #include <QTimer>
 
 #include <ros/ros.h>
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_benchmark_control.h>
-#include <roah_rsbb/CoreToGui.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/CoreState.h>
+#include "core_cache.h"
 
 
 
@@ -49,13 +47,14 @@ namespace rqt_roah_rsbb
       Ui::BenchmarkControl ui_;
       QWidget* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      std::shared_ptr<CoreCache> cache_;
 
-      std::set<std::string> known_zones_;
-      std::string current_zone_;
+      void select_current_zone();
 
     private slots:
-      void update();
+      void update_zones (unsigned flags);
+      void update (unsigned flags);
+      void tick();
       void zone (QString const& zone);
       void connect_s();
       void disconnect();
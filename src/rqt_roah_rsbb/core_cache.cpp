@@ -0,0 +1,523 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "core_cache.h"
+
+#include <QMetaObject>
+
+#include "current_zone.h"
+
+
+
+using namespace std;
+using namespace ros;
+
+
+
+namespace
+{
+  using rqt_roah_rsbb::CoreCache;
+
+  // The schema hash covers the names, types and descriptions, so only the
+  // values need to be compared
+  bool
+  equal_values (vector<roah_rsbb::ZoneScoreGroup> const& lhs,
+                vector<roah_rsbb::ZoneScoreGroup> const& rhs)
+  {
+    if (lhs.size() != rhs.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+      if (lhs[i].current_values != rhs[i].current_values) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool
+  operator== (roah_rsbb::RobotInfo const& lhs,
+              roah_rsbb::RobotInfo const& rhs)
+  {
+    return lhs.team == rhs.team
+           && lhs.robot == rhs.robot
+           && lhs.skew == rhs.skew
+           && lhs.beacon == rhs.beacon;
+  }
+
+  bool
+  operator== (roah_rsbb::ZoneTopic const& lhs,
+              roah_rsbb::ZoneTopic const& rhs)
+  {
+    return lhs.zone == rhs.zone
+           && lhs.topic == rhs.topic
+           && lhs.log_topic == rhs.log_topic;
+  }
+
+  template<typename T>
+  bool
+  equal (vector<T> const& lhs,
+         vector<T> const& rhs)
+  {
+    if (lhs.size() != rhs.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+      if (! (lhs[i] == rhs[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  unsigned
+  zone_diff (roah_rsbb::ZoneState const& a,
+             roah_rsbb::ZoneState const& b)
+  {
+    unsigned flags = 0;
+
+    if ( (a.name != b.name)
+         || (a.desc != b.desc)
+         || (a.code != b.code)
+         || (a.timeout != b.timeout)
+         || (a.team != b.team)
+         || (a.round != b.round)
+         || (a.run != b.run)
+         || (a.schedule != b.schedule)) {
+      flags |= CoreCache::ZONE_INFO;
+    }
+    if ( (a.timer != b.timer)
+         || (a.timer_deadline != b.timer_deadline)
+         || (a.timer_paused != b.timer_paused)
+         || (a.timer_delay != b.timer_delay)) {
+      flags |= CoreCache::ZONE_TIMER;
+    }
+    if ( (a.state != b.state)
+         || (a.connect_enabled != b.connect_enabled)
+         || (a.disconnect_enabled != b.disconnect_enabled)
+         || (a.start_enabled != b.start_enabled)
+         || (a.stop_enabled != b.stop_enabled)
+         || (a.prev_enabled != b.prev_enabled)
+         || (a.next_enabled != b.next_enabled)) {
+      flags |= CoreCache::ZONE_STATE;
+    }
+    if (a.manual_operation != b.manual_operation) {
+      flags |= CoreCache::ZONE_MANUAL_OPERATION;
+    }
+    if ( (a.omf != b.omf)
+         || (a.omf_switches != b.omf_switches)
+         || (a.omf_damaged != b.omf_damaged)
+         || (a.omf_complete != b.omf_complete)) {
+      flags |= CoreCache::ZONE_OMF;
+    }
+    if ( (a.scoring_schema != b.scoring_schema)
+         || (a.score_version != b.score_version)
+         || ! equal_values (a.scoring, b.scoring)) {
+      flags |= CoreCache::ZONE_SCORING;
+    }
+
+    return flags;
+  }
+
+  unsigned
+  core_diff (roah_rsbb::CoreState const& a,
+             roah_rsbb::CoreState const& b)
+  {
+    unsigned flags = 0;
+
+    if ( (a.status != b.status)
+         || (a.addr != b.addr)
+         || (a.port != b.port)) {
+      flags |= CoreCache::CORE_STATUS;
+    }
+    if (! equal (a.active_robots, b.active_robots)) {
+      flags |= CoreCache::CORE_ROBOTS;
+    }
+    if (! equal (a.zones, b.zones)) {
+      flags |= CoreCache::CORE_ZONES;
+    }
+    if ( (a.tablet_last_beacon != b.tablet_last_beacon)
+         || (a.tablet_display_map != b.tablet_display_map)
+         || (a.tablet_call_time != b.tablet_call_time)
+         || (a.tablet_position_time != b.tablet_position_time)
+         || (a.tablet_position_x != b.tablet_position_x)
+         || (a.tablet_position_y != b.tablet_position_y)) {
+      flags |= CoreCache::CORE_TABLET;
+    }
+
+    return flags;
+  }
+}
+
+
+
+namespace rqt_roah_rsbb
+{
+  shared_ptr<CoreCache> CoreCache::acquire (NodeHandle& nh)
+  {
+    // Plugins are only created and destroyed in the GUI thread
+    static weak_ptr<CoreCache> instance;
+
+    shared_ptr<CoreCache> cache = instance.lock();
+    if (! cache) {
+      cache.reset (new CoreCache (nh));
+      instance = cache;
+    }
+    return cache;
+  }
+
+  CoreCache::CoreCache (NodeHandle& nh)
+    : nh_ (nh)
+    , process_posted_ (false)
+    , stop_ (false)
+    , current_zone_ (get_current_zone())
+    , connected_ (false)
+    , log_capacity_ (0)
+  {
+    clear_logs();
+    backlog_thread_ = std::thread (&CoreCache::backlog_loop, this, nh_);
+    sub_ = nh_.subscribe ("/core/state", 1, &CoreCache::receive, this);
+
+    connect (&check_timer_, SIGNAL (timeout()), this, SLOT (check()));
+    check_timer_.start (500);
+  }
+
+  CoreCache::~CoreCache()
+  {
+    check_timer_.stop();
+    {
+      lock_guard<mutex> lock (pending_mutex_);
+      stop_ = true;
+    }
+    backlog_cond_.notify_one();
+    backlog_thread_.join();
+    // Wait for a receive() in progress
+    sub_.shutdown();
+    zone_sub_.shutdown();
+    log_sub_.shutdown();
+  }
+
+  Time CoreCache::core_now() const
+  {
+    Time now = Time::now();
+    if (! last_) {
+      return now;
+    }
+    return last_->clock + (now - last_time_);
+  }
+
+  void CoreCache::set_current_zone (string const& zone)
+  {
+    if (zone == current_zone_) {
+      return;
+    }
+    ros::param::set ("current_zone", zone);
+    select_zone (zone);
+  }
+
+  void CoreCache::select_zone (string const& zone)
+  {
+    current_zone_ = zone;
+    zone_.reset();
+    subscribe_zone();
+    emit current_zone_changed (ZONE_ALL);
+  }
+
+  void CoreCache::subscribe_zone()
+  {
+    string topic, log_topic;
+    if (last_) {
+      for (roah_rsbb::ZoneTopic const& zone : last_->zones) {
+        if (zone.zone == current_zone_) {
+          topic = zone.topic;
+          log_topic = zone.log_topic;
+          break;
+        }
+      }
+    }
+    if (topic == zone_topic_) {
+      return;
+    }
+
+    // Waits for the receive callbacks in progress, and drops what they left
+    zone_sub_.shutdown();
+    log_sub_.shutdown();
+    {
+      lock_guard<mutex> lock (pending_mutex_);
+      pending_zone_.reset();
+      pending_log_.clear();
+      backlog_requests_.clear();
+      pending_backlog_.clear();
+    }
+    clear_logs();
+    zone_topic_ = topic;
+    if (! topic.empty()) {
+      // Latched, so the current state arrives right away
+      zone_sub_ = nh_.subscribe (topic, 1, &CoreCache::receive_zone, this);
+      // Subscribed before fetching the backlog, so no entry is missed
+      log_sub_ = nh_.subscribe (log_topic, 100, &CoreCache::receive_log, this);
+      fetch_backlog (roah_rsbb::LogEntries::LOG);
+      fetch_backlog (roah_rsbb::LogEntries::ONLINE_DATA);
+    }
+  }
+
+  void CoreCache::clear_logs()
+  {
+    for (unsigned stream = 0; stream < 2; ++stream) {
+      Log& log = logs_[stream];
+      bool was_empty = log.entries.empty();
+      log.epoch = 0;
+      log.next_seq = 0;
+      log.entries.clear();
+      log.size = 0;
+      log.fetching = false;
+      log.held.clear();
+      if (! was_empty) {
+        emit log_reset (stream);
+      }
+    }
+  }
+
+  void CoreCache::fetch_backlog (unsigned stream)
+  {
+    Log& log = logs_[stream];
+    if (log.fetching) {
+      return;
+    }
+    log.fetching = true;
+
+    roah_rsbb::LogBacklog::Request request;
+    request.zone = current_zone_;
+    request.stream = stream;
+    lock_guard<mutex> lock (pending_mutex_);
+    backlog_requests_.push_back (request);
+    backlog_cond_.notify_one();
+  }
+
+  void CoreCache::apply_backlog (Backlog const& backlog)
+  {
+    roah_rsbb::LogBacklog::Request const& request = backlog.srv.request;
+    if ( (request.stream > roah_rsbb::LogEntries::ONLINE_DATA) || (request.zone != current_zone_)) {
+      return;
+    }
+    Log& log = logs_[request.stream];
+    if (! log.fetching) {
+      return;
+    }
+    log.fetching = false;
+
+    vector<roah_rsbb::LogEntries> held;
+    held.swap (log.held);
+    if (backlog.ok) {
+      log_capacity_ = backlog.srv.response.capacity;
+      apply_log (backlog.srv.response.entries, true);
+    }
+    else {
+      ROS_WARN_STREAM ("Failed to fetch the log backlog of zone " << request.zone);
+    }
+    // Entries also in the backlog are skipped, a gap fetches it again
+    for (auto const& i : held) {
+      apply_log (i, false);
+    }
+  }
+
+  void CoreCache::backlog_loop (NodeHandle nh)
+  {
+    ServiceClient client;
+    unique_lock<mutex> lock (pending_mutex_);
+    while (true) {
+      backlog_cond_.wait (lock, [this] () { return stop_ || ! backlog_requests_.empty(); });
+      if (stop_) {
+        return;
+      }
+      Backlog backlog;
+      backlog.srv.request = backlog_requests_.front();
+      backlog_requests_.pop_front();
+      lock.unlock();
+
+      if (! client.isValid()) {
+        client = nh.serviceClient<roah_rsbb::LogBacklog> ("/core/log_backlog", true);
+      }
+      backlog.ok = client.call (backlog.srv);
+
+      lock.lock();
+      pending_backlog_.push_back (move (backlog));
+      post_process();
+    }
+  }
+
+  void CoreCache::apply_log (roah_rsbb::LogEntries const& msg,
+                             bool backlog)
+  {
+    if ( (msg.stream > roah_rsbb::LogEntries::ONLINE_DATA) || (msg.zone != current_zone_)) {
+      return;
+    }
+    Log& log = logs_[msg.stream];
+    if ( (! backlog) && log.fetching) {
+      log.held.push_back (msg);
+      return;
+    }
+
+    bool reset = backlog || (msg.epoch != log.epoch);
+    if (reset) {
+      if ( (! backlog) && (msg.first_seq != 0)) {
+        // Joined a text already started, or missed its beginning
+        fetch_backlog (msg.stream);
+        log.held.push_back (msg);
+        return;
+      }
+      log.epoch = msg.epoch;
+      log.next_seq = msg.first_seq;
+      log.entries.clear();
+      log.size = 0;
+    }
+    else if (msg.first_seq > log.next_seq) {
+      // Entries were lost
+      fetch_backlog (msg.stream);
+      log.held.push_back (msg);
+      return;
+    }
+
+    // Entries already received from the backlog are skipped
+    unsigned count = 0;
+    for (size_t i = log.next_seq - msg.first_seq; i < msg.entries.size(); ++i) {
+      log.entries.push_back (msg.entries[i]);
+      log.size += msg.entries[i].size();
+      ++count;
+    }
+    log.next_seq = max (log.next_seq, msg.first_seq + msg.entries.size());
+    while (log_capacity_ && (log.size > log_capacity_) && (log.entries.size() > 1)) {
+      log.size -= log.entries.front().size();
+      log.entries.pop_front();
+    }
+
+    if (reset) {
+      emit log_reset (msg.stream);
+    }
+    else if (count) {
+      emit log_appended (msg.stream, count);
+    }
+  }
+
+  void CoreCache::post_process()
+  {
+    // With pending_mutex_ locked
+    if (! process_posted_) {
+      process_posted_ = true;
+      QMetaObject::invokeMethod (this, "process", Qt::QueuedConnection);
+    }
+  }
+
+  void CoreCache::receive (roah_rsbb::CoreState::ConstPtr const& msg)
+  {
+    // Called from the ROS spinner thread. Messages that arrive before the
+    // GUI thread gets to process() replace each other.
+    lock_guard<mutex> lock (pending_mutex_);
+    pending_ = msg;
+    pending_time_ = Time::now();
+    post_process();
+  }
+
+  void CoreCache::receive_zone (roah_rsbb::ZoneState::ConstPtr const& msg)
+  {
+    lock_guard<mutex> lock (pending_mutex_);
+    pending_zone_ = msg;
+    post_process();
+  }
+
+  void CoreCache::receive_log (roah_rsbb::LogEntries::ConstPtr const& msg)
+  {
+    lock_guard<mutex> lock (pending_mutex_);
+    pending_log_.push_back (msg);
+    post_process();
+  }
+
+  void CoreCache::process()
+  {
+    roah_rsbb::CoreState::ConstPtr msg;
+    roah_rsbb::ZoneState::ConstPtr zone_msg;
+    vector<roah_rsbb::LogEntries::ConstPtr> log_msgs;
+    vector<Backlog> backlogs;
+    Time time;
+    {
+      lock_guard<mutex> lock (pending_mutex_);
+      msg.swap (pending_);
+      zone_msg.swap (pending_zone_);
+      log_msgs.swap (pending_log_);
+      backlogs.swap (pending_backlog_);
+      time = pending_time_;
+      process_posted_ = false;
+    }
+
+    if (msg) {
+      unsigned core_flags = last_ ? core_diff (*last_, *msg) : (CORE_STATUS | CORE_ROBOTS | CORE_TABLET | CORE_ZONES);
+
+      if (! connected_) {
+        connected_ = true;
+        core_flags |= CORE_CONNECTION;
+      }
+
+      last_ = msg;
+      last_time_ = time;
+
+      if (core_flags) {
+        emit core_changed (core_flags);
+      }
+      if (core_flags & CORE_ZONES) {
+        // The current zone was removed, or moved to another topic
+        subscribe_zone();
+        if (zone_topic_.empty() && zone_) {
+          zone_.reset();
+          emit current_zone_changed (ZONE_ALL);
+        }
+      }
+    }
+
+    if (zone_msg && (zone_msg->zone == current_zone_)) {
+      unsigned flags = zone_ ? zone_diff (*zone_, *zone_msg) : ZONE_ALL;
+      zone_ = zone_msg;
+      if (flags) {
+        emit current_zone_changed (flags);
+      }
+    }
+
+    for (auto const& backlog : backlogs) {
+      apply_backlog (backlog);
+    }
+    for (auto const& log_msg : log_msgs) {
+      apply_log (*log_msg, false);
+    }
+  }
+
+  void CoreCache::check()
+  {
+    // Selected by a BenchmarkControl in another process
+    string zone = get_current_zone();
+    if (zone != current_zone_) {
+      select_zone (zone);
+    }
+
+    // The core publishes at least once per second (~gui_heartbeat)
+    bool connected = last_ && ( (Time::now() - last_time_) <= Duration (3));
+    if (connected != connected_) {
+      connected_ = connected;
+      emit core_changed (CORE_CONNECTION);
+    }
+  }
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RQT_ROAH_RSBB_CORE_CACHE_H__
+#define __RQT_ROAH_RSBB_CORE_CACHE_H__
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include <ros/ros.h>
+
+#include <roah_rsbb/CoreState.h>
+#include <roah_rsbb/LogBacklog.h>
+#include <roah_rsbb/LogEntries.h>
+#include <roah_rsbb/ZoneState.h>
+
+
+
+namespace rqt_roah_rsbb
+{
+  /*
+   * Subscriptions to /core/state and to the topics of the current zone,
+   * shared by all plugins loaded in the same process, so the traffic does
+   * not grow with the number of zones. Each message is deserialized once
+   * and only what changed is signalled, so plugins do not need to poll.
+   * The display texts of the zone are received as new entries only, after
+   * a backlog from /core/log_backlog when the zone is selected, fetched in
+   * backlog_thread_ so the GUI never waits for the core. Signals are
+   * emitted in the GUI thread, and the pointers returned stay valid until
+   * control returns to the event loop.
+   */
+  class CoreCache
+    : public QObject
+  {
+      Q_OBJECT
+
+    public:
+      // Flags of core_changed
+      enum {
+        CORE_STATUS = 1 << 0, // status, addr, port
+        CORE_ROBOTS = 1 << 1,
+        CORE_TABLET = 1 << 2,
+        CORE_ZONES = 1 << 3, // zones added or removed, or their topics
+        CORE_CONNECTION = 1 << 4, // communication lost or recovered
+      };
+
+      // Flags of current_zone_changed
+      enum {
+        ZONE_INFO = 1 << 0, // name, desc, code, timeout, team, round, run, schedule
+        ZONE_TIMER = 1 << 1,
+        ZONE_STATE = 1 << 2, // state and enabled controls
+        ZONE_MANUAL_OPERATION = 1 << 3,
+        ZONE_OMF = 1 << 4,
+        ZONE_SCORING = 1 << 5,
+        ZONE_ALL = (1 << 6) - 1,
+      };
+
+      /*
+       * Returns the instance of this process, creating it if needed. It is
+       * destroyed when the last plugin releases it.
+       */
+      static std::shared_ptr<CoreCache>
+      acquire (ros::NodeHandle& nh);
+
+      ~CoreCache();
+
+      // Null until the first message is received
+      roah_rsbb::CoreState::ConstPtr
+      last() const
+      {
+        return last_;
+      }
+
+      bool
+      connected() const
+      {
+        return connected_;
+      }
+
+      // The core only publishes on changes, so its clock is extrapolated
+      ros::Time
+      core_now() const;
+
+      std::string const&
+      current_zone_name() const
+      {
+        return current_zone_;
+      }
+
+      // Null until the state of the current zone is received
+      roah_rsbb::ZoneState const*
+      current_zone() const
+      {
+        return zone_.get();
+      }
+
+      // Entries of a display text of the current zone, stream is
+      // roah_rsbb::LogEntries::LOG or ONLINE_DATA
+      std::deque<std::string> const&
+      log (unsigned stream) const
+      {
+        return logs_[stream].entries;
+      }
+
+      // Used by BenchmarkControl, other processes pick it up from the parameter
+      void
+      set_current_zone (std::string const& zone);
+
+    signals:
+      void core_changed (unsigned flags);
+      // Also emitted with ZONE_ALL when another zone is selected
+      void current_zone_changed (unsigned flags);
+      // All entries of log (stream) were replaced
+      void log_reset (unsigned stream);
+      // count entries were added at the end of log (stream), older ones may
+      // have been removed from its beginning
+      void log_appended (unsigned stream, unsigned count);
+
+    private:
+      ros::NodeHandle nh_;
+      ros::Subscriber sub_;
+      ros::Subscriber zone_sub_;
+      std::string zone_topic_;
+      ros::Subscriber log_sub_;
+      QTimer check_timer_;
+
+      std::mutex pending_mutex_;
+      roah_rsbb::CoreState::ConstPtr pending_;
+      ros::Time pending_time_;
+      roah_rsbb::ZoneState::ConstPtr pending_zone_;
+      // Not coalesced, each carries different entries
+      std::vector<roah_rsbb::LogEntries::ConstPtr> pending_log_;
+      bool process_posted_;
+
+      // Requests for backlog_thread_ and its results, guarded by
+      // pending_mutex_
+      struct Backlog {
+        roah_rsbb::LogBacklog srv;
+        bool ok;
+      };
+      std::thread backlog_thread_;
+      std::condition_variable backlog_cond_;
+      std::deque<roah_rsbb::LogBacklog::Request> backlog_requests_;
+      std::vector<Backlog> pending_backlog_;
+      bool stop_;
+
+      roah_rsbb::CoreState::ConstPtr last_;
+      ros::Time last_time_;
+      roah_rsbb::ZoneState::ConstPtr zone_;
+      std::string current_zone_;
+      bool connected_;
+
+      struct Log {
+        uint64_t epoch;
+        uint64_t next_seq;
+        std::deque<std::string> entries;
+        size_t size;
+        // While a backlog is fetched, new entries are held to be applied
+        // after it
+        bool fetching;
+        std::vector<roah_rsbb::LogEntries> held;
+      };
+      Log logs_[2];
+      // Characters kept for each stream, as told by the core with each
+      // backlog. 0, unlimited, until the first one
+      size_t log_capacity_;
+
+      CoreCache (ros::NodeHandle& nh);
+
+      void
+      post_process();
+
+      void
+      receive (roah_rsbb::CoreState::ConstPtr const& msg);
+
+      void
+      receive_zone (roah_rsbb::ZoneState::ConstPtr const& msg);
+
+      void
+      receive_log (roah_rsbb::LogEntries::ConstPtr const& msg);
+
+      void
+      apply_log (roah_rsbb::LogEntries const& msg,
+                 bool backlog);
+
+      void
+      fetch_backlog (unsigned stream);
+
+      void
+      apply_backlog (Backlog const& backlog);
+
+      void
+      backlog_loop (ros::NodeHandle nh);
+
+      void
+      clear_logs();
+
+      // Subscribes to the topic of the current zone, if it changed
+      void
+      subscribe_zone();
+
+      void
+      select_zone (std::string const& zone);
+
+    private slots:
+      void process();
+      void check();
+  };
+}
+
+#endif
@@ -56,31 +56,27 @@ namespace rqt_roah_rsbb
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
-
-    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
-    update_timer_.start (200);
+    cache_ = CoreCache::acquire (getNodeHandle());
+    connect (cache_.get(), SIGNAL (core_changed (unsigned)), this, SLOT (update()));
+    update();
   }
 
   void CoreStatus::shutdownPlugin()
   {
-    update_timer_.stop();
-    core_rcv_.stop();
+    cache_->disconnect (this);
+    cache_.reset();
   }
 
   void CoreStatus::update()
   {
-    Time now = Time::now();
-
-    Time core_status_time;
-    auto core_status = core_rcv_.last (core_status_time);
+    auto core_status = cache_->last();
 
     if (! core_status) {
       ui_.status->setText ("Waiting for core...");
       return;
     }
 
-    if ( (now - core_status_time) > Duration (1)) {
+    if (! cache_->connected()) {
       ui_.status->setText ("No communication!");
       ui_.addr->setText ("--");
       ui_.port->setText ("--");
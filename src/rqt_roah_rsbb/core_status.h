@@ -20,14 +20,12 @@
 #ifndef __RQT_ROAH_RSBB_CORE_STATUS_H__
 #define __RQT_ROAH_RSBB_CORE_STATUS_H__
 
-#include <QTimer>
-
 #include <ros/ros.h>
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_core_status.h>
-#include <roah_rsbb/CoreToGui.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/CoreState.h>
+#include "core_cache.h"
 
 
 
@@ -46,8 +44,7 @@ namespace rqt_roah_rsbb
     private:
       Ui::CoreStatus ui_;
       QWidget* widget_;
-      QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      std::shared_ptr<CoreCache> cache_;
 
     private slots:
       void update();
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RQT_ROAH_RSBB_CURRENT_ZONE_H__
+#define __RQT_ROAH_RSBB_CURRENT_ZONE_H__
+
+#include <string>
+
+#include <ros/ros.h>
+
+
+
+namespace rqt_roah_rsbb
+{
+  /*
+   * The zone selected in the BenchmarkControl plugin, shared with the other
+   * plugins through the parameter server. getCached subscribes to updates
+   * of the parameter, so the master is only contacted on the first call.
+   */
+  inline std::string
+  get_current_zone()
+  {
+    std::string zone;
+    if (! ros::param::getCached ("current_zone", zone)) {
+      return std::string();
+    }
+    return zone;
+  }
+}
+
+#endif
@@ -21,7 +21,6 @@
 
 #include <QStringList>
 #include <QMessageBox>
-#include <QScrollBar>
 
 #include <pluginlib/class_list_macros.h>
 
@@ -57,42 +56,40 @@ namespace rqt_roah_rsbb
     widget_ = new QWidget();
     // extend the widget with all attributes and children from UI file
     ui_.setupUi (widget_);
+    view_.set_display (ui_.display);
 
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
-
-    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
-    update_timer_.start (200);
+    cache_ = CoreCache::acquire (getNodeHandle());
+    connect (cache_.get(), SIGNAL (log_reset (unsigned)), this, SLOT (reset (unsigned)));
+    connect (cache_.get(), SIGNAL (log_appended (unsigned, unsigned)), this, SLOT (append (unsigned, unsigned)));
+    reset (roah_rsbb::LogEntries::LOG);
   }
 
   void LogDisplay::shutdownPlugin()
   {
-    update_timer_.stop();
-    core_rcv_.stop();
+    cache_->disconnect (this);
+    cache_.reset();
+  }
+
+  void LogDisplay::reset (unsigned stream)
+  {
+    if (stream != roah_rsbb::LogEntries::LOG) {
+      return;
+    }
+
+    view_.reset (cache_->log (stream));
   }
 
-  void LogDisplay::update()
+  void LogDisplay::append (unsigned stream,
+                           unsigned count)
   {
-    auto core = core_rcv_.last ();
-    string current_zone = param_direct ("current_zone", string());
-
-    if (core) {
-      for (roah_rsbb::ZoneState const& zone : core->zones) {
-        if (zone.zone == current_zone) {
-          QString new_text = QString::fromStdString (zone.log);
-          if (ui_.display->toPlainText() != new_text) {
-            ui_.display->setPlainText (new_text);
-            QScrollBar* sb = ui_.display->verticalScrollBar();
-            sb->setValue (sb->maximum());
-          }
-          return;
-        }
-      }
+    if (stream != roah_rsbb::LogEntries::LOG) {
+      return;
     }
 
-    ui_.display->clear();
+    view_.append (cache_->log (stream), count);
   }
 }
 
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "log_view.h"
+
+#include <algorithm>
+
+#include <QScrollBar>
+#include <QTextCursor>
+
+
+
+using namespace std;
+
+
+
+namespace rqt_roah_rsbb
+{
+  void LogView::reset (deque<string> const& log)
+  {
+    lengths_.clear();
+    QString text;
+    for (string const& entry : log) {
+      QString e = QString::fromStdString (entry);
+      lengths_.push_back (e.size());
+      text += e;
+    }
+    display_->setPlainText (text);
+    scroll_to_end();
+  }
+
+  void LogView::append (deque<string> const& log,
+                        unsigned count)
+  {
+    size_t shown = min<size_t> (count, log.size());
+
+    int removed = 0;
+    while ( (! lengths_.empty()) && (lengths_.size() + shown > log.size())) {
+      removed += lengths_.front();
+      lengths_.pop_front();
+    }
+
+    QTextCursor cursor (display_->document());
+    if (removed) {
+      cursor.setPosition (min (removed, display_->document()->characterCount() - 1), QTextCursor::KeepAnchor);
+      cursor.removeSelectedText();
+    }
+
+    QString text;
+    for (auto i = log.end() - shown; i != log.end(); ++i) {
+      QString e = QString::fromStdString (*i);
+      lengths_.push_back (e.size());
+      text += e;
+    }
+    cursor.movePosition (QTextCursor::End);
+    cursor.insertText (text);
+    scroll_to_end();
+  }
+
+  void LogView::scroll_to_end()
+  {
+    QScrollBar* sb = display_->verticalScrollBar();
+    sb->setValue (sb->maximum());
+  }
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RQT_ROAH_RSBB_LOG_VIEW_H__
+#define __RQT_ROAH_RSBB_LOG_VIEW_H__
+
+#include <deque>
+#include <string>
+
+#include <QPlainTextEdit>
+
+
+
+namespace rqt_roah_rsbb
+{
+  /*
+   * Shows a display text of CoreCache. Only new entries are laid out, and
+   * the ones the cache dropped are removed from the beginning, so the
+   * document never holds more than the cache.
+   */
+  class LogView
+  {
+    public:
+      LogView()
+        : display_ (0)
+      {
+      }
+
+      void
+      set_display (QPlainTextEdit* display)
+      {
+        display_ = display;
+      }
+
+      void
+      reset (std::deque<std::string> const& log);
+
+      // count entries were added at the end of log
+      void
+      append (std::deque<std::string> const& log,
+              unsigned count);
+
+    private:
+      QPlainTextEdit* display_;
+      // Characters of each entry shown, as counted by the document
+      std::deque<int> lengths_;
+
+      void
+      scroll_to_end();
+  };
+}
+
+#endif
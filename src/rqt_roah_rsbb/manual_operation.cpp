@@ -63,38 +63,34 @@ namespace rqt_roah_rsbb
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
-
-    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
-    update_timer_.start (200);
-
     default_palette_ = ui_.mo->palette();
     warn_palette_ = ui_.mo->palette();
     warn_palette_.setColor (QPalette::All, QPalette::Base, Qt::yellow);
     warn_palette_.setColor (QPalette::All, QPalette::Text, Qt::black);
+
+    cache_ = CoreCache::acquire (getNodeHandle());
+    connect (cache_.get(), SIGNAL (current_zone_changed (unsigned)), this, SLOT (update (unsigned)));
+    update (CoreCache::ZONE_ALL);
   }
 
   void ManualOperation::shutdownPlugin()
   {
-    update_timer_.stop();
-    core_rcv_.stop();
+    cache_->disconnect (this);
+    cache_.reset();
   }
 
-  void ManualOperation::update()
+  void ManualOperation::update (unsigned flags)
   {
-    auto core = core_rcv_.last ();
-    string current_zone = param_direct ("current_zone", string());
-
-    if (core) {
-      for (roah_rsbb::ZoneState const& zone : core->zones) {
-        if ( (zone.zone == current_zone)
-             && (! zone.manual_operation.empty())) {
-          ui_.mo->setPalette (warn_palette_);
-          ui_.mo_complete->setEnabled (true);
-          ui_.mo->setPlainText (QString::fromStdString (zone.manual_operation));
-          return;
-        }
-      }
+    if (! (flags & CoreCache::ZONE_MANUAL_OPERATION)) {
+      return;
+    }
+
+    roah_rsbb::ZoneState const* zone = cache_->current_zone();
+    if (zone && (! zone->manual_operation.empty())) {
+      ui_.mo->setPalette (warn_palette_);
+      ui_.mo_complete->setEnabled (true);
+      ui_.mo->setPlainText (QString::fromStdString (zone->manual_operation));
+      return;
     }
 
     ui_.mo->setPalette (default_palette_);
@@ -105,7 +101,7 @@ namespace rqt_roah_rsbb
   void ManualOperation::complete()
   {
     roah_rsbb::ZoneManualOperationResult z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.manual_operation_result = ui_.mo_result->toPlainText().toStdString();
     ui_.mo_result->setPlainText("");
     call_service ("/core/manual_operation_complete", z);
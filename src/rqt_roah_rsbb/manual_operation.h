@@ -20,14 +20,12 @@
 #ifndef __RQT_ROAH_RSBB_MANUAL_OPERATION_H__
 #define __RQT_ROAH_RSBB_MANUAL_OPERATION_H__
 
-#include <QTimer>
-
 #include <ros/ros.h>
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_manual_operation.h>
-#include <roah_rsbb/CoreToGui.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/ZoneState.h>
+#include "core_cache.h"
 
 
 
@@ -46,13 +44,12 @@ namespace rqt_roah_rsbb
     private:
       Ui::ManualOperation ui_;
       QWidget* widget_;
-      QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      std::shared_ptr<CoreCache> cache_;
       QPalette default_palette_;
       QPalette warn_palette_;
 
     private slots:
-      void update();
+      void update (unsigned flags);
       void complete();
   };
 }
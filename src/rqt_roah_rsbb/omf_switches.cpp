@@ -113,11 +113,6 @@ namespace rqt_roah_rsbb
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
-
-    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
-    update_timer_.start (200);
-
     number_to_buttons_[buttonsmap[0]] = ui_.a;
     number_to_buttons_[buttonsmap[1]] = ui_.b;
     number_to_buttons_[buttonsmap[2]] = ui_.c;
@@ -128,12 +123,21 @@ namespace rqt_roah_rsbb
     number_to_buttons_[buttonsmap[7]] = ui_.h;
     number_to_buttons_[buttonsmap[8]] = ui_.i;
     number_to_buttons_[buttonsmap[9]] = ui_.j;
+
+    cache_ = CoreCache::acquire (getNodeHandle());
+    connect (cache_.get(), SIGNAL (current_zone_changed (unsigned)), this, SLOT (update (unsigned)));
+
+    update_timer_.setSingleShot (true);
+    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (refresh()));
+
+    refresh();
   }
 
   void OmfSwitches::shutdownPlugin()
   {
     update_timer_.stop();
-    core_rcv_.stop();
+    cache_->disconnect (this);
+    cache_.reset();
   }
 
   void OmfSwitches::disable()
@@ -164,61 +168,62 @@ namespace rqt_roah_rsbb
     ui_.complete->setEnabled (false);
   }
 
-  void OmfSwitches::update()
+  void OmfSwitches::update (unsigned flags)
+  {
+    if (flags & CoreCache::ZONE_OMF) {
+      refresh();
+    }
+  }
+
+  void OmfSwitches::refresh()
   {
     Time now = Time::now();
 
-    auto core = core_rcv_.last ();
-    string current_zone = param_direct ("current_zone", string());
-
-    if (core) {
-      for (roah_rsbb::ZoneState const& zone : core->zones) {
-        if (zone.zone == current_zone) {
-          if (! zone.omf) {
-            break;
-          }
-
-          if (! ui_.a->isEnabled()) {
-            ui_.a->setEnabled (true);
-            ui_.b->setEnabled (true);
-            ui_.c->setEnabled (true);
-            ui_.d->setEnabled (true);
-            ui_.e->setEnabled (true);
-            ui_.f->setEnabled (true);
-            ui_.g->setEnabled (true);
-            ui_.h->setEnabled (true);
-            ui_.i->setEnabled (true);
-            ui_.j->setEnabled (true);
-            ui_.damaged->setEnabled (true);
-          }
-
-          ui_.complete->setEnabled (zone.omf_complete);
-
-          if ( (now - last_control_) < CONTROL_DURATION) {
-            return;
-          }
-
-          ui_.a->setChecked (false);
-          ui_.b->setChecked (false);
-          ui_.c->setChecked (false);
-          ui_.d->setChecked (false);
-          ui_.e->setChecked (false);
-          ui_.f->setChecked (false);
-          ui_.g->setChecked (false);
-          ui_.h->setChecked (false);
-          ui_.i->setChecked (false);
-          ui_.j->setChecked (false);
-          for (auto const& i : zone.omf_switches) {
-            number_to_buttons_.at (i)->setChecked (true);
-          }
-
-          if (ui_.damaged->value() != static_cast<int> (zone.omf_damaged)) {
-            ui_.damaged->setValue (zone.omf_damaged);
-          }
-
-          return;
-        }
+    roah_rsbb::ZoneState const* zone = cache_->current_zone();
+    if (zone && zone->omf) {
+      if (! ui_.a->isEnabled()) {
+        ui_.a->setEnabled (true);
+        ui_.b->setEnabled (true);
+        ui_.c->setEnabled (true);
+        ui_.d->setEnabled (true);
+        ui_.e->setEnabled (true);
+        ui_.f->setEnabled (true);
+        ui_.g->setEnabled (true);
+        ui_.h->setEnabled (true);
+        ui_.i->setEnabled (true);
+        ui_.j->setEnabled (true);
+        ui_.damaged->setEnabled (true);
       }
+
+      ui_.complete->setEnabled (zone->omf_complete);
+
+      // Do not override the referee, the core may not reflect the last
+      // control yet
+      Duration since_control = now - last_control_;
+      if (since_control < CONTROL_DURATION) {
+        update_timer_.start (static_cast<int> ( (CONTROL_DURATION - since_control).toSec() * 1000) + 1);
+        return;
+      }
+
+      ui_.a->setChecked (false);
+      ui_.b->setChecked (false);
+      ui_.c->setChecked (false);
+      ui_.d->setChecked (false);
+      ui_.e->setChecked (false);
+      ui_.f->setChecked (false);
+      ui_.g->setChecked (false);
+      ui_.h->setChecked (false);
+      ui_.i->setChecked (false);
+      ui_.j->setChecked (false);
+      for (auto const& i : zone->omf_switches) {
+        number_to_buttons_.at (i)->setChecked (true);
+      }
+
+      if (ui_.damaged->value() != static_cast<int> (zone->omf_damaged)) {
+        ui_.damaged->setValue (zone->omf_damaged);
+      }
+
+      return;
     }
 
     disable();
@@ -227,7 +232,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::complete()
   {
     roah_rsbb::Zone z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     call_service ("/core/omf_switches/complete", z);
 
     disable();
@@ -236,7 +241,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::damaged (int value)
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = value;
     call_service ("/core/omf_switches/damaged", z);
     last_control_ = Time::now();
@@ -245,7 +250,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::a()
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = buttonsmap[0];
     call_service ("/core/omf_switches/button", z);
     last_control_ = Time::now();
@@ -254,7 +259,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::b()
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = buttonsmap[1];
     call_service ("/core/omf_switches/button", z);
     last_control_ = Time::now();
@@ -263,7 +268,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::c()
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = buttonsmap[2];
     call_service ("/core/omf_switches/button", z);
     last_control_ = Time::now();
@@ -272,7 +277,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::d()
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = buttonsmap[3];
     call_service ("/core/omf_switches/button", z);
     last_control_ = Time::now();
@@ -281,7 +286,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::e()
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = buttonsmap[4];
     call_service ("/core/omf_switches/button", z);
     last_control_ = Time::now();
@@ -290,7 +295,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::f()
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = buttonsmap[5];
     call_service ("/core/omf_switches/button", z);
     last_control_ = Time::now();
@@ -299,7 +304,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::g()
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = buttonsmap[6];
     call_service ("/core/omf_switches/button", z);
     last_control_ = Time::now();
@@ -308,7 +313,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::h()
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = buttonsmap[7];
     call_service ("/core/omf_switches/button", z);
     last_control_ = Time::now();
@@ -317,7 +322,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::i()
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = buttonsmap[8];
     call_service ("/core/omf_switches/button", z);
     last_control_ = Time::now();
@@ -326,7 +331,7 @@ namespace rqt_roah_rsbb
   void OmfSwitches::j()
   {
     roah_rsbb::ZoneUInt8 z;
-    z.request.zone = param_direct ("current_zone", string());
+    z.request.zone = cache_->current_zone_name();
     z.request.data = buttonsmap[9];
     call_service ("/core/omf_switches/button", z);
     last_control_ = Time::now();
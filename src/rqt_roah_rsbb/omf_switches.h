@@ -28,8 +28,8 @@
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_omf_switches.h>
-#include <roah_rsbb/CoreToGui.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/ZoneState.h>
+#include "core_cache.h"
 
 
 
@@ -49,7 +49,7 @@ namespace rqt_roah_rsbb
       Ui::OmfSwitches ui_;
       QWidget* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      std::shared_ptr<CoreCache> cache_;
       const ros::Duration CONTROL_DURATION;
       ros::Time last_control_;
       std::map <int, QPushButton*> number_to_buttons_;
@@ -57,7 +57,8 @@ namespace rqt_roah_rsbb
       void disable();
 
     private slots:
-      void update();
+      void update (unsigned flags);
+      void refresh();
       void complete();
       void damaged (int value);
       void a();
@@ -20,14 +20,13 @@
 #ifndef __RQT_ROAH_RSBB_ONLINE_DATA_H__
 #define __RQT_ROAH_RSBB_ONLINE_DATA_H__
 
-#include <QTimer>
-
 #include <ros/ros.h>
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_online_data.h>
-#include <roah_rsbb/CoreToGui.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/LogEntries.h>
+#include "core_cache.h"
+#include "log_view.h"
 
 
 
@@ -46,11 +45,13 @@ namespace rqt_roah_rsbb
     private:
       Ui::OnlineData ui_;
       QWidget* widget_;
-      QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      std::shared_ptr<CoreCache> cache_;
+      LogView view_;
 
     private slots:
-      void update();
+      void reset (unsigned stream);
+      void append (unsigned stream,
+                   unsigned count);
   };
 }
 
@@ -37,11 +37,19 @@ PublicDisplay::PublicDisplay()
   : nh_()
   , screen_srv_ (nh_.advertiseService ("screen", &PublicDisplay::set_screen, this))
   , core_to_public_sub_ (nh_.subscribe ("/core/to_public", 1, &PublicDisplay::core_to_public, this))
+  , clock_sub_ (nh_.subscribe ("/core/clock", 1, &PublicDisplay::core_clock, this))
+  , has_clock_ (false)
+  , schedule_model_ (new rqt_roah_rsbb::TableModel (QStringList() << "Time" << "Team" << "Benchmark" << "Round" << "Run", this))
+  , schedule_changed_ (true)
+  , schedule_width_ (-1)
 {
   setObjectName ("PublicDisplay");
 
   ui_.setupUi (this);
 
+  schedule_model_->set_highlight (QColor (247, 204, 6));
+  schedule_model_->set_alignment (Qt::AlignCenter);
+  ui_.schedule->setModel (schedule_model_);
   ui_.schedule->horizontalHeader()->setResizeMode (QHeaderView::Fixed);
 
   connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
@@ -85,39 +93,34 @@ bool PublicDisplay::set_screen (roah_rsbb::UInt8::Request& req,
 
 void PublicDisplay::core_to_public (roah_rsbb::CoreToPublic::ConstPtr const& msg)
 {
-  ui_.clock->setText (QString::fromStdString (msg->clock));
-
-  ui_.schedule->setRowCount (msg->schedule.size());
-
+  // The core only publishes when the schedule changes
+  vector<rqt_roah_rsbb::TableRow> rows (msg->schedule.size());
   for (size_t r = 0; r < msg->schedule.size(); ++r) {
-    QTableWidgetItem* c0 = new QTableWidgetItem (QString::fromStdString (msg->schedule.at (r).time));
-    QTableWidgetItem* c1 = new QTableWidgetItem (QString::fromStdString (msg->schedule.at (r).team));
-    QTableWidgetItem* c2 = new QTableWidgetItem (QString::fromStdString (msg->schedule.at (r).benchmark));
-    QTableWidgetItem* c3 = new QTableWidgetItem (QString::number (msg->schedule.at (r).round));
-    QTableWidgetItem* c4 = new QTableWidgetItem (QString::number (msg->schedule.at (r).run));
-    if (msg->schedule.at (r).running) {
-      QColor selected (247, 204, 6);
-      c0->setTextColor (selected);
-      c1->setTextColor (selected);
-      c2->setTextColor (selected);
-      c3->setTextColor (selected);
-      c4->setTextColor (selected);
-    }
-    c0->setTextAlignment (Qt::AlignCenter);
-    c1->setTextAlignment (Qt::AlignCenter);
-    c2->setTextAlignment (Qt::AlignCenter);
-    c3->setTextAlignment (Qt::AlignCenter);
-    c4->setTextAlignment (Qt::AlignCenter);
-    ui_.schedule->setItem (r, 0, c0);
-    ui_.schedule->setItem (r, 1, c1);
-    ui_.schedule->setItem (r, 2, c2);
-    ui_.schedule->setItem (r, 3, c3);
-    ui_.schedule->setItem (r, 4, c4);
+    roah_rsbb::ScheduleInfo const& info = msg->schedule.at (r);
+    rows[r].cells << QString::fromStdString (info.time)
+                  << QString::fromStdString (info.team)
+                  << QString::fromStdString (info.benchmark)
+                  << QString::number (info.round)
+                  << QString::number (info.run);
+    rows[r].highlight = info.running;
+  }
+
+  if (schedule_model_->set (rows)) {
+    schedule_changed_ = true;
   }
 }
 
 
 
+void PublicDisplay::core_clock (std_msgs::Time::ConstPtr const& msg)
+{
+  // Every ~gui_heartbeat, the clock is extrapolated in between
+  clock_offset_ = msg->data - Time::now();
+  has_clock_ = true;
+}
+
+
+
 void PublicDisplay::update()
 {
   spinOnce();
@@ -125,13 +128,33 @@ void PublicDisplay::update()
     QApplication::quit();
   }
 
-  int width = ui_.schedule->horizontalHeader()->width();
+  if (has_clock_) {
+    Time core_now = Time::now() + clock_offset_;
+    ui_.clock->setText (to_qstring (Time (core_now.sec, 0)));
+  }
+
+  if (schedule_changed_ || (ui_.schedule->horizontalHeader()->width() != schedule_width_)) {
+    fit_columns();
+  }
+}
+
+
+
+void PublicDisplay::fit_columns()
+{
+  schedule_changed_ = false;
+  schedule_width_ = ui_.schedule->horizontalHeader()->width();
+
+  int columns = schedule_model_->columnCount();
   ui_.schedule->horizontalHeader()->resizeSections (QHeaderView::ResizeToContents);
   int smallw = 0;
-  for (int i = 0; i < 5; ++i) {
+  for (int i = 0; i < columns; ++i) {
     smallw += ui_.schedule->columnWidth (i);
   }
-  for (int i = 0; i < 5; ++i) {
-    ui_.schedule->setColumnWidth (i, width * ui_.schedule->columnWidth (i) / smallw);
+  if (smallw == 0) {
+    return;
+  }
+  for (int i = 0; i < columns; ++i) {
+    ui_.schedule->setColumnWidth (i, schedule_width_ * ui_.schedule->columnWidth (i) / smallw);
   }
 }
@@ -28,6 +28,8 @@
 #include <ui_public_display.h>
 #include <roah_rsbb/UInt8.h>
 #include <roah_rsbb/CoreToPublic.h>
+#include <std_msgs/Time.h>
+#include "table_model.h"
 
 
 
@@ -46,12 +48,23 @@ class PublicDisplay
     QTimer update_timer_;
     ros::ServiceServer screen_srv_;
     ros::Subscriber core_to_public_sub_;
+    ros::Subscriber clock_sub_;
+    ros::Duration clock_offset_;
+    bool has_clock_;
+    rqt_roah_rsbb::TableModel* schedule_model_;
+    // Column widths are only computed again when these change
+    bool schedule_changed_;
+    int schedule_width_;
 
     bool set_screen (roah_rsbb::UInt8::Request& req,
                      roah_rsbb::UInt8::Response& res);
 
     void core_to_public (roah_rsbb::CoreToPublic::ConstPtr const& msg);
 
+    void core_clock (std_msgs::Time::ConstPtr const& msg);
+
+    void fit_columns();
+
   private slots:
     void update();
 };
@@ -26,6 +26,8 @@
 #include <QCheckBox>
 #include <QSpinBox>
 
+#include <algorithm>
+
 #include <pluginlib/class_list_macros.h>
 
 #include <roah_utils.h>
@@ -38,27 +40,6 @@ using namespace ros;
 
 
 
-namespace std
-{
-  inline bool
-  operator== (const roah_rsbb::ZoneScoreGroup& lhs,
-              const roah_rsbb::ZoneScoreGroup& rhs)
-  {
-    return lhs.group_name == rhs.group_name
-           && lhs.types == rhs.types
-           && lhs.current_values == rhs.current_values
-           && lhs.descriptions == rhs.descriptions;
-  }
-  inline bool
-  operator!= (const roah_rsbb::ZoneScoreGroup& lhs,
-              const roah_rsbb::ZoneScoreGroup& rhs)
-  {
-    return ! (lhs == rhs);
-  }
-}
-
-
-
 namespace rqt_roah_rsbb
 {
   Scoring::Scoring()
@@ -66,6 +47,11 @@ namespace rqt_roah_rsbb
     , widget_ (0)
     , CONTROL_DURATION (1.0)
     , last_control_ (TIME_MIN)
+    , last_schema_ (0)
+    , submitting_ (false)
+    , stop_ (false)
+    , acked_schema_ (0)
+    , acked_version_ (0)
   {
     setObjectName ("Scoring");
   }
@@ -83,128 +69,254 @@ namespace rqt_roah_rsbb
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
+    cache_ = CoreCache::acquire (getNodeHandle());
+    connect (cache_.get(), SIGNAL (current_zone_changed (unsigned)), this, SLOT (update (unsigned)));
 
-    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
-    update_timer_.start (500);
+    update_timer_.setSingleShot (true);
+    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (check_update()));
+
+    submit_thread_ = std::thread (&Scoring::submit_loop, this, getNodeHandle());
+
+    rebuild();
   }
 
   void Scoring::shutdownPlugin()
   {
+    {
+      lock_guard<mutex> lock (submit_mutex_);
+      stop_ = true;
+    }
+    submit_cond_.notify_one();
+    submit_thread_.join();
+
     update_timer_.stop();
-    core_rcv_.stop();
+    cache_->disconnect (this);
+    cache_.reset();
   }
 
-  void Scoring::update()
+  void Scoring::update (unsigned flags)
   {
-    Time now = Time::now();
+    if (! (flags & CoreCache::ZONE_SCORING)) {
+      return;
+    }
+
+    check_update();
+  }
 
-    auto core_status = core_rcv_.last ();
-    if (! core_status) {
+  void Scoring::check_update()
+  {
+    roah_rsbb::ZoneState const* zone = cache_->current_zone();
+    if (! zone
+        || (zone->zone != last_zone_)
+        || (zone->scoring_schema != last_schema_)) {
+      rebuild();
       return;
     }
 
-    if ( (now - last_control_) < CONTROL_DURATION) {
+    // Do not update under the referee: wait until the queued changes are
+    // applied and the cache reflects their version. The version restarts
+    // with each run, so give up waiting after CONTROL_DURATION.
+    unique_lock<mutex> lock (submit_mutex_);
+    if (submitting_) {
+      return; // submitted() will check again
+    }
+    bool behind = (zone->zone == acked_zone_)
+                  && (zone->scoring_schema == acked_schema_)
+                  && (zone->score_version < acked_version_);
+    lock.unlock();
+
+    Duration since_control = Time::now() - last_control_;
+    if (behind && (since_control < CONTROL_DURATION)) {
+      update_timer_.start (static_cast<int> ( (CONTROL_DURATION - since_control).toSec() * 1000) + 1);
       return;
     }
 
-    string current_zone = param_direct ("current_zone", string());
-    for (roah_rsbb::ZoneState const& zone : core_status->zones) {
-      if (zone.zone == current_zone) {
-        if (zone.scoring == last_scoring_) {
-          return;
-        }
+    update_values (*zone);
+  }
 
-        QWidget().setLayout (ui_.layout);
-        ui_.setupUi (widget_);
-        service_template_.clear();
-
-        last_scoring_ = zone.scoring;
-
-        for (roah_rsbb::ZoneScoreGroup const& score_group : zone.scoring) {
-          auto gridGroupBox = new QGroupBox (QString::fromStdString (score_group.group_name));
-          QGridLayout* layout = new QGridLayout;
-
-          for (size_t i = 0 ; i < score_group.types.size() ; ++i) {
-            switch (score_group.types[i]) {
-              case roah_rsbb::ZoneScoreGroup::SCORING_BOOL: {
-                QCheckBox* checkbox = new QCheckBox();
-                checkbox->setCheckState (score_group.current_values.at (i) ? Qt::Checked : Qt::Unchecked);
-                checkbox->setSizePolicy (QSizePolicy::Maximum, QSizePolicy::Maximum);
-                QHBoxLayout* pLayout = new QHBoxLayout();
-                pLayout->addWidget (checkbox);
-                pLayout->setAlignment (Qt::AlignCenter);
-                pLayout->setContentsMargins (0, 0, 0, 0);
-                layout->addLayout (pLayout, i, 0);
-
-                connect (checkbox, SIGNAL (stateChanged (int)), this, SLOT (check_cb (int)));
-
-                roah_rsbb::ZoneScore tmp;
-                tmp.request.zone = current_zone;
-                tmp.request.score.group = score_group.group_name;
-                tmp.request.score.desc = score_group.descriptions.at (i);
-                service_template_[checkbox] = tmp;
-              }
-              break;
-              case roah_rsbb::ZoneScoreGroup::SCORING_UINT: {
-                auto spinbox = new QSpinBox();
-                spinbox->setValue (score_group.current_values.at (i));
-                layout->addWidget (spinbox, i, 0);
-
-                connect (spinbox, SIGNAL (valueChanged (int)), this, SLOT (spin_cb (int)));
-
-                roah_rsbb::ZoneScore tmp;
-                tmp.request.zone = current_zone;
-                tmp.request.score.group = score_group.group_name;
-                tmp.request.score.desc = score_group.descriptions.at (i);
-                service_template_[spinbox] = tmp;
-              }
-              break;
-            }
-            layout->addWidget (new QLabel (QString::fromStdString (score_group.descriptions.at (i))), i, 1);
+  void Scoring::update_values (roah_rsbb::ZoneState const& zone)
+  {
+    for (roah_rsbb::ZoneScoreGroup const& score_group : zone.scoring) {
+      for (size_t i = 0 ; i < score_group.current_values.size() ; ++i) {
+        size_t id = score_group.first_id + i;
+        if (id >= items_.size()) {
+          continue;
+        }
+        int32_t value = score_group.current_values[i];
+        ItemWidget const& item = items_[id];
+        // Signals are blocked, as these changes come from the core
+        if (item.checkbox) {
+          Qt::CheckState state = value ? Qt::Checked : Qt::Unchecked;
+          if (item.checkbox->checkState() != state) {
+            item.checkbox->blockSignals (true);
+            item.checkbox->setCheckState (state);
+            item.checkbox->blockSignals (false);
+          }
+        }
+        else if (item.spinbox) {
+          if (item.spinbox->value() != value) {
+            item.spinbox->blockSignals (true);
+            item.spinbox->setValue (value);
+            item.spinbox->blockSignals (false);
           }
-
-          layout->setColumnStretch (1, 1);
-          gridGroupBox->setLayout (layout);
-          ui_.layout->addWidget (gridGroupBox);
         }
-
-        return;
       }
     }
+  }
 
+  void Scoring::rebuild()
+  {
     QWidget().setLayout (ui_.layout);
     ui_.setupUi (widget_);
+    items_.clear();
+    item_ids_.clear();
+
+    roah_rsbb::ZoneState const* zone = cache_->current_zone();
+    if (! zone) {
+      last_zone_.clear();
+      last_schema_ = 0;
+      return;
+    }
+
+    last_zone_ = zone->zone;
+    last_schema_ = zone->scoring_schema;
+
+    for (roah_rsbb::ZoneScoreGroup const& score_group : zone->scoring) {
+      auto gridGroupBox = new QGroupBox (QString::fromStdString (score_group.group_name));
+      QGridLayout* layout = new QGridLayout;
+
+      for (size_t i = 0 ; i < score_group.types.size() ; ++i) {
+        uint16_t id = score_group.first_id + i;
+        if (items_.size() <= id) {
+          items_.resize (id + 1);
+        }
+        switch (score_group.types[i]) {
+          case roah_rsbb::ZoneScoreGroup::SCORING_BOOL: {
+            QCheckBox* checkbox = new QCheckBox();
+            checkbox->setCheckState (score_group.current_values.at (i) ? Qt::Checked : Qt::Unchecked);
+            checkbox->setSizePolicy (QSizePolicy::Maximum, QSizePolicy::Maximum);
+            QHBoxLayout* pLayout = new QHBoxLayout();
+            pLayout->addWidget (checkbox);
+            pLayout->setAlignment (Qt::AlignCenter);
+            pLayout->setContentsMargins (0, 0, 0, 0);
+            layout->addLayout (pLayout, i, 0);
+
+            connect (checkbox, SIGNAL (stateChanged (int)), this, SLOT (check_cb (int)));
+
+            items_[id].checkbox = checkbox;
+            item_ids_[checkbox] = id;
+          }
+          break;
+          case roah_rsbb::ZoneScoreGroup::SCORING_UINT: {
+            auto spinbox = new QSpinBox();
+            spinbox->setValue (score_group.current_values.at (i));
+            layout->addWidget (spinbox, i, 0);
+
+            connect (spinbox, SIGNAL (valueChanged (int)), this, SLOT (spin_cb (int)));
+
+            items_[id].spinbox = spinbox;
+            item_ids_[spinbox] = id;
+          }
+          break;
+        }
+        layout->addWidget (new QLabel (QString::fromStdString (score_group.descriptions.at (i))), i, 1);
+      }
+
+      layout->setColumnStretch (1, 1);
+      gridGroupBox->setLayout (layout);
+      ui_.layout->addWidget (gridGroupBox);
+    }
   }
 
-  void Scoring::check_cb (int value)
+  void Scoring::queue_score (QObject* widget,
+                             int32_t value)
   {
-    auto t_i = service_template_.find (sender());
-    if (t_i != service_template_.end()) {
-      roah_rsbb::ZoneScore tmp = t_i->second;
-      tmp.request.score.value = (value == Qt::Unchecked) ? 0 : 1;
-      ROS_INFO_STREAM ("Setting \"" << tmp.request.score.desc << "\" to " << value);
-      call_service ("/core/set_score", tmp);
+    auto id = item_ids_.find (widget);
+    if (id == item_ids_.end()) {
+      ROS_WARN ("Did not find widget in item_ids_, thus not setting score.");
+      return;
+    }
+
+    roah_rsbb::Score score;
+    score.id = id->second;
+    score.value = value;
+    ROS_INFO_STREAM ("Setting scoring item " << score.id << " to " << value);
+
+    lock_guard<mutex> lock (submit_mutex_);
+    if (pending_.empty()
+        || (pending_.back().request.zone != last_zone_)
+        || (pending_.back().request.schema != last_schema_)) {
+      pending_.push_back (roah_rsbb::SetScores());
+      pending_.back().request.zone = last_zone_;
+      pending_.back().request.schema = last_schema_;
+    }
+    vector<roah_rsbb::Score>& scores = pending_.back().request.scores;
+    auto s = find_if (scores.begin(), scores.end(),
+                      [&score] (roah_rsbb::Score const& i) { return i.id == score.id; });
+    if (s != scores.end()) {
+      s->value = value;
     }
     else {
-      ROS_WARN ("Did not find checkbox in service_template_, thus not calling service and not setting score.");
+      scores.push_back (score);
     }
-    last_control_ = Time::now();
+    submitting_ = true;
+    submit_cond_.notify_one();
   }
 
-  void Scoring::spin_cb (int value)
+  void Scoring::submit_loop (NodeHandle nh)
   {
-    auto t_i = service_template_.find (sender());
-    if (t_i != service_template_.end()) {
-      roah_rsbb::ZoneScore tmp = t_i->second;
-      tmp.request.score.value = value;
-      ROS_INFO_STREAM ("Setting \"" << tmp.request.score.desc << "\" to " << value);
-      call_service ("/core/set_score", tmp);
-    }
-    else {
-      ROS_WARN ("Did not find spinner in service_template_, thus not calling service and not setting score.");
+    ServiceClient client;
+    unique_lock<mutex> lock (submit_mutex_);
+    while (true) {
+      submit_cond_.wait (lock, [this] () { return stop_ || ! pending_.empty(); });
+      if (pending_.empty()) {
+        return;
+      }
+      roah_rsbb::SetScores srv = pending_.front();
+      pending_.pop_front();
+      lock.unlock();
+
+      if (! client.isValid()) {
+        client = nh.serviceClient<roah_rsbb::SetScores> ("/core/set_scores", true);
+      }
+      bool ok = client.call (srv);
+
+      lock.lock();
+      if (ok && srv.response.pending) {
+        // Applied later by the core, the version is not known, so rely on
+        // CONTROL_DURATION only
+        ROS_WARN_STREAM ("Setting " << srv.request.scores.size() << " scores in zone " << srv.request.zone << " is pending in the core");
+      }
+      else if (ok) {
+        ROS_DEBUG_STREAM ("Scores applied, version " << srv.response.version);
+        acked_zone_ = srv.request.zone;
+        acked_schema_ = srv.request.schema;
+        acked_version_ = srv.response.version;
+      }
+      else {
+        ROS_ERROR_STREAM ("Failed to set " << srv.request.scores.size() << " scores in zone " << srv.request.zone);
+      }
+      if (pending_.empty()) {
+        submitting_ = false;
+        QMetaObject::invokeMethod (this, "submitted", Qt::QueuedConnection);
+      }
     }
+  }
+
+  void Scoring::submitted()
+  {
     last_control_ = Time::now();
+    check_update();
+  }
+
+  void Scoring::check_cb (int value)
+  {
+    queue_score (sender(), (value == Qt::Unchecked) ? 0 : 1);
+  }
+
+  void Scoring::spin_cb (int value)
+  {
+    queue_score (sender(), value);
   }
 }
 
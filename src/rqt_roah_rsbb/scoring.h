@@ -20,18 +20,24 @@
 #ifndef __RQT_ROAH_RSBB_SCORING_H__
 #define __RQT_ROAH_RSBB_SCORING_H__
 
-#include <vector>
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+#include <QCheckBox>
+#include <QSpinBox>
 #include <QTimer>
 
 #include <ros/ros.h>
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_scoring.h>
-#include <roah_rsbb/CoreToGui.h>
-#include <roah_rsbb/ZoneScore.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/ZoneState.h>
+#include <roah_rsbb/SetScores.h>
+#include "core_cache.h"
 
 
 
@@ -51,14 +57,50 @@ namespace rqt_roah_rsbb
       Ui::Scoring ui_;
       QScrollArea* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      std::shared_ptr<CoreCache> cache_;
       const ros::Duration CONTROL_DURATION;
       ros::Time last_control_;
-      std::vector<roah_rsbb::ZoneScoreGroup> last_scoring_;
-      std::map<QObject*, roah_rsbb::ZoneScore> service_template_;
+      std::string last_zone_;
+      uint32_t last_schema_;
+
+      // Widgets are only created when the zone or the scoring schema
+      // change, values are then updated in place
+      struct ItemWidget {
+        QCheckBox* checkbox;
+        QSpinBox* spinbox;
+
+        ItemWidget()
+          : checkbox (0)
+          , spinbox (0)
+        {
+        }
+      };
+      std::vector<ItemWidget> items_;
+      std::map<QObject*, uint16_t> item_ids_;
+
+      // Changes are sent from submit_thread_, so that the GUI never waits
+      // for the core. Changes made while a request is in flight are merged
+      // into the next one.
+      std::thread submit_thread_;
+      std::mutex submit_mutex_;
+      std::condition_variable submit_cond_;
+      std::deque<roah_rsbb::SetScores> pending_;
+      bool submitting_;
+      bool stop_;
+      std::string acked_zone_;
+      uint32_t acked_schema_;
+      uint32_t acked_version_;
+
+      void update_values (roah_rsbb::ZoneState const& zone);
+      void queue_score (QObject* widget,
+                        int32_t value);
+      void submit_loop (ros::NodeHandle nh);
 
     private slots:
-      void update();
+      void update (unsigned flags);
+      void check_update();
+      void rebuild();
+      void submitted();
       void check_cb (int value);
       void spin_cb (int value);
   };
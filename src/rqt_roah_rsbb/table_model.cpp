@@ -0,0 +1,124 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "table_model.h"
+
+#include <algorithm>
+
+
+
+using namespace std;
+
+
+
+namespace rqt_roah_rsbb
+{
+  TableModel::TableModel (QStringList const& headers,
+                          QObject* parent)
+    : QAbstractTableModel (parent)
+    , headers_ (headers)
+  {
+  }
+
+  bool TableModel::set (vector<TableRow> const& rows)
+  {
+    // Rows equal at both ends are kept, the ones in between are updated in
+    // place and the rest inserted or removed
+    size_t begin = 0;
+    while ( (begin < rows_.size()) && (begin < rows.size()) && (rows_[begin] == rows[begin])) {
+      ++begin;
+    }
+    size_t old_end = rows_.size();
+    size_t new_end = rows.size();
+    while ( (old_end > begin) && (new_end > begin) && (rows_[old_end - 1] == rows[new_end - 1])) {
+      --old_end;
+      --new_end;
+    }
+
+    bool text_changed = false;
+    size_t common = min (old_end, new_end) - begin;
+    for (size_t i = begin; i < begin + common; ++i) {
+      if (rows_[i].cells != rows[i].cells) {
+        text_changed = true;
+      }
+      rows_[i] = rows[i];
+    }
+    if (common) {
+      emit dataChanged (index (begin, 0), index (begin + common - 1, headers_.size() - 1));
+    }
+
+    if (new_end > old_end) {
+      beginInsertRows (QModelIndex(), begin + common, new_end - 1);
+      rows_.insert (rows_.begin() + begin + common, rows.begin() + begin + common, rows.begin() + new_end);
+      endInsertRows();
+      text_changed = true;
+    }
+    else if (old_end > new_end) {
+      beginRemoveRows (QModelIndex(), begin + common, old_end - 1);
+      rows_.erase (rows_.begin() + begin + common, rows_.begin() + old_end);
+      endRemoveRows();
+      text_changed = true;
+    }
+
+    return text_changed;
+  }
+
+  int TableModel::rowCount (QModelIndex const& parent) const
+  {
+    return parent.isValid() ? 0 : rows_.size();
+  }
+
+  int TableModel::columnCount (QModelIndex const& parent) const
+  {
+    return parent.isValid() ? 0 : headers_.size();
+  }
+
+  QVariant TableModel::data (QModelIndex const& index,
+                             int role) const
+  {
+    if ( (! index.isValid())
+         || (index.row() >= static_cast<int> (rows_.size()))
+         || (index.column() >= rows_[index.row()].cells.size())) {
+      return QVariant();
+    }
+
+    TableRow const& row = rows_[index.row()];
+    switch (role) {
+      case Qt::DisplayRole:
+        return row.cells.at (index.column());
+      case Qt::TextAlignmentRole:
+        return alignment_;
+      case Qt::ForegroundRole:
+        return row.highlight ? highlight_ : QVariant();
+      default:
+        return QVariant();
+    }
+  }
+
+  QVariant TableModel::headerData (int section,
+                                   Qt::Orientation orientation,
+                                   int role) const
+  {
+    if ( (orientation == Qt::Horizontal) && (role == Qt::DisplayRole)
+         && (section >= 0) && (section < headers_.size())) {
+      return headers_.at (section);
+    }
+    return QVariant();
+  }
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2014 Instituto de Sistemas e Robotica, Instituto Superior Tecnico
+ *
+ * This file is part of RoAH RSBB.
+ *
+ * RoAH RSBB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RoAH RSBB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RoAH RSBB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RQT_ROAH_RSBB_TABLE_MODEL_H__
+#define __RQT_ROAH_RSBB_TABLE_MODEL_H__
+
+#include <vector>
+
+#include <QAbstractTableModel>
+#include <QColor>
+#include <QStringList>
+#include <QVariant>
+
+
+
+namespace rqt_roah_rsbb
+{
+  struct TableRow {
+    QStringList cells;
+    bool highlight;
+
+    TableRow()
+      : highlight (false)
+    {
+    }
+
+    bool
+    operator== (TableRow const& other) const
+    {
+      return (cells == other.cells) && (highlight == other.highlight);
+    }
+  };
+
+  /*
+   * Read only table of text. set() compares the new rows with the current
+   * ones and only signals the rows that were inserted, removed or changed,
+   * so views do not lay out the whole table again for every message.
+   */
+  class TableModel
+    : public QAbstractTableModel
+  {
+      Q_OBJECT
+
+    public:
+      TableModel (QStringList const& headers,
+                  QObject* parent = 0);
+
+      // Text color of highlighted rows
+      void
+      set_highlight (QColor const& color)
+      {
+        highlight_ = color;
+      }
+
+      void
+      set_alignment (Qt::Alignment alignment)
+      {
+        alignment_ = static_cast<int> (alignment);
+      }
+
+      /*
+       * Returns true if the text of any cell changed, so the caller knows
+       * when column widths need to be computed again.
+       */
+      bool
+      set (std::vector<TableRow> const& rows);
+
+      int rowCount (QModelIndex const& parent = QModelIndex()) const;
+      int columnCount (QModelIndex const& parent = QModelIndex()) const;
+      QVariant data (QModelIndex const& index,
+                     int role = Qt::DisplayRole) const;
+      QVariant headerData (int section,
+                           Qt::Orientation orientation,
+                           int role = Qt::DisplayRole) const;
+
+    private:
+      QStringList headers_;
+      std::vector<TableRow> rows_;
+      QVariant highlight_;
+      QVariant alignment_;
+  };
+}
+
+#endif
@@ -61,23 +61,34 @@ namespace rqt_roah_rsbb
     // add widget to the user interface
     context.addWidget (widget_);
 
-    core_rcv_.start ("/core/to_gui", getNodeHandle());
+    cache_ = CoreCache::acquire (getNodeHandle());
+    connect (cache_.get(), SIGNAL (core_changed (unsigned)), this, SLOT (update (unsigned)));
+    refresh();
 
-    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (update()));
-    update_timer_.start (100);
+    // The beacon age and the warnings change without a new message
+    connect (&update_timer_, SIGNAL (timeout()), this, SLOT (refresh()));
+    update_timer_.start (250);
   }
 
   void TabletStatus::shutdownPlugin()
   {
     update_timer_.stop();
-    core_rcv_.stop();
+    cache_->disconnect (this);
+    cache_.reset();
   }
 
-  void TabletStatus::update()
+  void TabletStatus::update (unsigned flags)
+  {
+    if (flags & CoreCache::CORE_TABLET) {
+      refresh();
+    }
+  }
+
+  void TabletStatus::refresh()
   {
     Time now = Time::now();
 
-    auto core = core_rcv_.last ();
+    auto core = cache_->last();
 
     if (! core) {
       return;
@@ -26,8 +26,8 @@
 #include <rqt_gui_cpp/plugin.h>
 
 #include <ui_tablet_status.h>
-#include <roah_rsbb/CoreToGui.h>
-#include "topic_receiver.h"
+#include <roah_rsbb/CoreState.h>
+#include "core_cache.h"
 
 
 
@@ -47,7 +47,7 @@ namespace rqt_roah_rsbb
       Ui::TabletStatus ui_;
       QWidget* widget_;
       QTimer update_timer_;
-      TopicReceiver<roah_rsbb::CoreToGui> core_rcv_;
+      std::shared_ptr<CoreCache> cache_;
       const ros::Duration WARN_DURATION;
       ros::Time last_call_rcvd_;
       ros::Time last_call_time_;
@@ -55,7 +55,8 @@ namespace rqt_roah_rsbb
       ros::Time last_pos_time_;
 
     private slots:
-      void update();
+      void update (unsigned flags);
+      void refresh();
   };
 }
 